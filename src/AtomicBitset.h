@@ -0,0 +1,87 @@
+#pragma once
+
+#ifndef ATOMIC_BITSET_H
+#define ATOMIC_BITSET_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include "HugePageAllocator.h"
+
+/**
+ * @brief Fixed size bitset whose bits can be set and reset from several threads at the same time.
+ * Used for per-voxel flags, where parallel carving writes neighbouring bits that share a word.
+ */
+class AtomicBitset {
+private:
+	HugePageVector<std::atomic<uint64_t>> storage;
+	std::atomic<uint64_t>* words; // storage or external memory
+	size_t bits;
+
+	static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t) && std::atomic<uint64_t>::is_always_lock_free,
+		"external words are accessed as atomics in place");
+
+public:
+	/**
+	 * @brief Bitset of size bits, all reset. Without initialise the words are left untouched until they are written with fillWords
+	 * (e.g. in parallel by the threads that use them later, see Model::fillParallel).
+	 */
+	AtomicBitset(size_t size = 0, bool initialise = true) : storage((size + 63) / 64), words(storage.data()), bits(size) {
+		if (initialise) {
+			fillWords(0, wordCount(), false);
+		}
+	}
+
+	/**
+	 * @brief Bitset over (size + 63) / 64 words of external memory (e.g. a mapped file), which has to be 8 byte aligned and outlive the bitset.
+	 */
+	AtomicBitset(uint64_t* external, size_t size) : words(reinterpret_cast<std::atomic<uint64_t>*>(external)), bits(size) {}
+
+	size_t size() const { return bits; }
+	size_t wordCount() const { return (bits + 63) / 64; }
+
+	bool test(size_t i) const {
+		return (words[i >> 6].load(std::memory_order_relaxed) >> (i & 63)) & 1;
+	}
+
+	void set(size_t i) {
+		uint64_t bit = uint64_t(1) << (i & 63);
+		// most bits are already set when a voxel is seen by another view, reading avoids the locked write
+		if (!(words[i >> 6].load(std::memory_order_relaxed) & bit)) {
+			words[i >> 6].fetch_or(bit, std::memory_order_relaxed);
+		}
+	}
+
+	/**
+	 * @brief Sets the bit and returns its previous value. Exactly one of several threads setting the same bit gets false.
+	 */
+	bool testAndSet(size_t i) {
+		uint64_t bit = uint64_t(1) << (i & 63);
+		if (words[i >> 6].load(std::memory_order_relaxed) & bit) {
+			return true;
+		}
+		return words[i >> 6].fetch_or(bit, std::memory_order_relaxed) & bit;
+	}
+
+	void reset(size_t i) {
+		uint64_t bit = uint64_t(1) << (i & 63);
+		if (words[i >> 6].load(std::memory_order_relaxed) & bit) {
+			words[i >> 6].fetch_and(~bit, std::memory_order_relaxed);
+		}
+	}
+
+	/**
+	 * @brief Sets or resets all bits of the words [begin, end), not thread safe for bits of these words set at the same time.
+	 */
+	void fillWords(size_t begin, size_t end, bool value) {
+		for (size_t i = begin; i < end; i++) {
+			words[i].store(value ? ~uint64_t(0) : 0, std::memory_order_relaxed);
+		}
+	}
+
+	void setAll() {
+		fillWords(0, wordCount(), true);
+	}
+};
+
+#endif
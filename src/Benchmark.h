@@ -3,6 +3,12 @@
 #include<Eigen/Dense>
 #include<chrono>
 #include<ctime>
+#ifdef __linux__
+#include<cstring>
+#include<linux/perf_event.h>
+#include<sys/syscall.h>
+#include<unistd.h>
+#endif
 
 using namespace std::chrono;
 
@@ -30,6 +36,8 @@ private:
 		postProcessing = std::vector<Performance>();
 		marchingCubes = std::vector<Performance>();
 		overall = std::vector<Performance>();
+		cacheMisses = std::vector<long long>();
+		OpenCacheCounter();
 		// initialize dummy run to avoid exceptions when benchmarking is disabled
 		NextRun("dummy", Eigen::Vector4f());
 	}
@@ -46,6 +54,34 @@ private:
 
 	std::vector<Performance> overall;
 
+	// cache misses of the runs (overall) in the thread that created the benchmark, -1 if the hardware counter is not available
+	std::vector<long long> cacheMisses;
+	int cacheCounter = -1;
+
+	void OpenCacheCounter() {
+#ifdef __linux__
+		// counts the calling thread only, the workers of the thread pool are not included (run with a single thread for complete counts)
+		perf_event_attr attr;
+		std::memset(&attr, 0, sizeof(attr));
+		attr.size = sizeof(attr);
+		attr.type = PERF_TYPE_HARDWARE;
+		attr.config = PERF_COUNT_HW_CACHE_MISSES;
+		attr.exclude_kernel = 1;
+		attr.exclude_hv = 1;
+		cacheCounter = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+	}
+
+	long long ReadCacheCounter() {
+		long long count = -1;
+#ifdef __linux__
+		if (cacheCounter >= 0 && read(cacheCounter, &count, sizeof(count)) != sizeof(count)) {
+			count = -1;
+		}
+#endif
+		return count;
+	}
+
 public:
 	Benchmark(Benchmark const&) = delete;
 
@@ -76,6 +112,7 @@ public:
 		postProcessing.push_back(Performance());
 		marchingCubes.push_back(Performance());
 		overall.push_back(Performance());
+		cacheMisses.push_back(-1);
 	}
 
 	/**
@@ -121,6 +158,13 @@ public:
 	*/
 	void LogOverall(bool start) {
 		PERFORMANCE_LOG(overall.back(), start);
+		long long count = ReadCacheCounter();
+		if (start) {
+			cacheMisses.back() = count;
+		}
+		else {
+			cacheMisses.back() = count < 0 || cacheMisses.back() < 0 ? -1 : count - cacheMisses.back();
+		}
 	}
 
 	/**
@@ -133,8 +177,8 @@ public:
 		ss << std::endl << "Benchmark (all times in milliseconds)" << std::endl;
 		// write table hadder
 		ss << "Name\t\t\t\t" << "|  Model size (x,y,z, voxel size)\t" << "|  Carving time\t" << "|  Coloring time\t" <<
-			"|  Postprocessing time\t" << "|  Marching cubes time\t" << "|  Overall time" << std::endl;
-		for (int i = 0; i < 177; i++) {
+			"|  Postprocessing time\t" << "|  Marching cubes time\t" << "|  Overall time\t" << "|  Cache misses" << std::endl;
+		for (int i = 0; i < 201; i++) {
 			ss << "-";
 		}
 		ss << std::endl;
@@ -143,7 +187,13 @@ public:
 			ss << runNames.at(i) << "|  " <<
 				modelSizes.at(i).x() << "x" << modelSizes.at(i).y() << "x" << modelSizes.at(i).z() << ", " << modelSizes.at(i)(3) << "\t\t\t|  " <<
 				TIME(carving.at(i)) << "\t|  " << TIME(coloring.at(i)) << "\t\t|  " << TIME(postProcessing.at(i)) << "\t\t|  " <<
-				TIME(marchingCubes.at(i)) << "\t\t|  " << TIME(overall.at(i)) << std::endl;
+				TIME(marchingCubes.at(i)) << "\t\t|  " << TIME(overall.at(i)) << "\t|  ";
+			if (cacheMisses.at(i) < 0) {
+				ss << "n/a" << std::endl;
+			}
+			else {
+				ss << cacheMisses.at(i) << std::endl;
+			}
 		}
 
 		return ss.str();
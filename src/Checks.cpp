@@ -0,0 +1,439 @@
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+#include "Checks.h"
+#include "Projection.h"
+#include "Model.h"
+#include "ViewSet.h"
+#include "VoxelCarving.h"
+#include "ColorReconstruction.h"
+
+// points per row, enough for a few packed iterations and a remainder
+#define CHECK_ROW_LENGTH 37
+// voxels per edge of the grids of the row and engine checks (the latter is no multiple of the brick size)
+#define CHECK_ROW_GRID 256
+#define CHECK_ENGINE_GRID 90
+// views of the synthetic scene of the engine checks
+#define CHECK_VIEWS 6
+// distance (in pixels) to the edge between two pixels within which a projection in float may round differently than the exact one
+#define CHECK_EDGE_TOLERANCE 1e-3
+
+/**
+ * @brief Compares the pixels of a row of both kernels, logs the first difference.
+ */
+static bool sameRow(const std::string& name, const std::vector<int>& px, const std::vector<int>& py, const std::vector<int>& qx, const std::vector<int>& qy) {
+	for (int k = 0; k < CHECK_ROW_LENGTH; k++) {
+		if (px[k] != qx[k] || py[k] != qy[k]) {
+			std::cerr << "LOG(ERR) - Check: " << name << " point " << k << " is (" << px[k] << ", " << py[k] << ") packed and ("
+				<< qx[k] << ", " << qy[k] << ") portable." << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool checkProjectionKernels() {
+	std::cout << "LOG - Check: projection kernels (" << projectionKernel() << " against portable)." << std::endl;
+	// u = X, v = Y, w = Z, so the rows choose the projected coordinates directly
+	cv::Mat identity = cv::Mat::eye(3, 4, CV_32F);
+	struct Row {
+		const char* name;
+		cv::Vec4f start;
+		cv::Vec4f step;
+	};
+	std::vector<Row> rows = {
+		{ "w crossing 0", cv::Vec4f(1000, -1000, -1.8e-5f, 1), cv::Vec4f(0, 0, 1e-6f, 0) },
+		{ "coordinates beyond the int range", cv::Vec4f(3e9f, -3e9f, 1, 0), cv::Vec4f(-1.5e8f, 1.5e8f, 0, 0) },
+		{ "coordinates around 2^31", cv::Vec4f(2.147e9f, -2.147e9f, 1, 0), cv::Vec4f(1e5f, -1e5f, 0, 0) },
+		{ "NaN", cv::Vec4f(0, 0, 0, 0), cv::Vec4f(0, 0, 0, 0) },
+		{ "infinity", cv::Vec4f(1, -1, 0, 0), cv::Vec4f(0, 0, 0, 0) },
+		{ "halfway cases", cv::Vec4f(-9.5f, 9.5f, 1, 0), cv::Vec4f(0.5f, -0.5f, 0, 0) },
+		{ "image", cv::Vec4f(-0.3f, 0.2f, 1.1f, 1), cv::Vec4f(0.013f, -0.007f, 0.002f, 0) }
+	};
+
+	// lens of a wide camera with strong distortion, points beyond a normalized radius of 1 are not valid
+	LensModel lens = { 500, 500, 320, 240, -0.3f, 0.1f, 1e-3f, -1e-3f, 0.01f, 0, 0, 0, 1.f };
+
+	bool ok = true;
+	std::vector<int> px(CHECK_ROW_LENGTH), py(CHECK_ROW_LENGTH), qx(CHECK_ROW_LENGTH), qy(CHECK_ROW_LENGTH);
+	for (const Row& row : rows) {
+		projectRow(identity, row.start, row.step, CHECK_ROW_LENGTH, px.data(), py.data());
+		projectRowScalar(identity, row.start, row.step, CHECK_ROW_LENGTH, qx.data(), qy.data());
+		ok = sameRow(row.name, px, py, qx, qy) && ok;
+
+		projectRow(identity, lens, row.start, row.step, CHECK_ROW_LENGTH, px.data(), py.data());
+		projectRowScalar(identity, lens, row.start, row.step, CHECK_ROW_LENGTH, qx.data(), qy.data());
+		ok = sameRow(std::string(row.name) + " (distorted)", px, py, qx, qy) && ok;
+	}
+	// the sentinel of points that can't be projected is exactly INT_MIN, footprints rely on it
+	projectRow(identity, rows[1].start, rows[1].step, CHECK_ROW_LENGTH, px.data(), py.data());
+	if (px[0] != INT_MIN || py[0] != INT_MIN) {
+		std::cerr << "LOG(ERR) - Check: coordinates beyond the int range are not mapped to INT_MIN." << std::endl;
+		ok = false;
+	}
+	std::cout << "LOG - Check: projection kernels " << (ok ? "passed." : "FAILED.") << std::endl;
+	return ok;
+}
+
+/**
+ * @brief Distance of a pixel coordinate to the nearest edge between two pixels (halfway between two pixel centres).
+ */
+static double edgeDistance(double coord) {
+	return std::fabs(coord - std::floor(coord) - 0.5);
+}
+
+/**
+ * @brief Distance of the exact projection of a point to the nearest pixel edge, computed in double precision.
+ *
+ * @param P			3x4 projection matrix, or pose if lens is given (CV_32F)
+ * @param lens		intrinsics and distortion coefficients of distorted projections, nullptr otherwise
+ * @param world		homogeneous world coordinates
+ */
+static double edgeDistance(const cv::Mat& P, const LensModel* lens, const cv::Vec4d& world) {
+	double h[3];
+	for (int r = 0; r < 3; r++) {
+		h[r] = 0;
+		for (int c = 0; c < 4; c++) {
+			h[r] += (double)P.at<float>(r, c) * world[c];
+		}
+	}
+	double u = h[0] / h[2], v = h[1] / h[2];
+	if (lens) {
+		double r2 = u * u + v * v;
+		double radial = (1 + r2 * (lens->k1 + r2 * (lens->k2 + r2 * lens->k3))) / (1 + r2 * (lens->k4 + r2 * (lens->k5 + r2 * lens->k6)));
+		double xd = u * radial + 2 * lens->p1 * u * v + lens->p2 * (r2 + 2 * u * u);
+		double yd = v * radial + lens->p1 * (r2 + 2 * v * v) + 2 * lens->p2 * u * v;
+		u = lens->fx * xd + lens->cx;
+		v = lens->fy * yd + lens->cy;
+	}
+	return std::min(edgeDistance(u), edgeDistance(v));
+}
+
+bool checkRowProjection() {
+	std::cout << "LOG - Check: row projection of a " << CHECK_ROW_GRID << "^3 grid (rows split at any voxel, single voxels and projectVoxel against whole rows)." << std::endl;
+	// a real camera (1280 x 960) looking at a grid centred at the world origin from an oblique pose
+	float K[9] = { 1123.4f, 0, 643.7f, 0, 1121.9f, 481.2f, 0, 0, 1 };
+	float Rt[12] = { 0.8253f, -0.5646f, 0.0109f, 0.021f, -0.2144f, -0.2947f, 0.9312f, -0.034f, -0.5225f, -0.7708f, -0.3643f, 1.31f };
+	cv::Mat pose(3, 4, CV_32F, Rt), projection = cv::Mat(3, 3, CV_32F, K) * pose;
+	LensModel lens = { K[0], K[4], K[2], K[5], -0.12f, 0.05f, 1e-3f, -5e-4f, 0, 0, 0, 0, 4.f };
+	Model model(1, 1, 1, 0.6f / CHECK_ROW_GRID, ModelStorage::Compact, cv::Vec3i(-CHECK_ROW_GRID / 2, -CHECK_ROW_GRID / 2, -CHECK_ROW_GRID / 2));
+
+	bool ok = true;
+	for (int distorted = 0; distorted < 2; distorted++) {
+		const cv::Mat& P = distorted ? pose : projection;
+		auto row = [&](const cv::Vec4f& start, int n, int* px, int* py, int first) {
+			distorted ? projectRow(P, lens, start, model.rowStep(), n, px, py, first) : projectRow(P, start, model.rowStep(), n, px, py, first);
+		};
+		std::vector<int> px(CHECK_ROW_GRID), py(CHECK_ROW_GRID), qx(CHECK_ROW_GRID), qy(CHECK_ROW_GRID);
+		long split = 0, single = 0, voxel = 0, beyond = 0;
+		double closest = 0;
+		for (int z = 0; z < CHECK_ROW_GRID; z++) {
+			for (int y = 0; y < CHECK_ROW_GRID; y++) {
+				cv::Vec4f start = model.rowStart(y, z);
+				row(start, CHECK_ROW_GRID, px.data(), py.data(), model.rowPoint(0));
+				int first = (7 * y + 13 * z) % CHECK_ROW_GRID;
+				row(start, CHECK_ROW_GRID - first, qx.data() + first, qy.data() + first, model.rowPoint(first));
+				for (int x = 0; x < CHECK_ROW_GRID; x++) {
+					cv::Point pixel(px[x], py[x]);
+					split += x >= first && (qx[x] != pixel.x || qy[x] != pixel.y);
+					cv::Point point = distorted ? projectRowPoint(P, lens, start, model.rowStep(), model.rowPoint(x)) : projectRowPoint(P, start, model.rowStep(), model.rowPoint(x));
+					single += point != pixel;
+
+					// projectVoxel computes the voxel centre instead of stepping to it, both may only differ on pixel edges
+					cv::Vec4f world = model.toWord(x, y, z);
+					if ((distorted ? projectVoxel(P, lens, world) : projectVoxel(P, world)) != pixel) {
+						voxel++;
+						double size = model.getSize();
+						cv::Vec3i offset = model.getOffset();
+						cv::Vec4d exact((y + offset(1)) * size, (x + offset(0)) * size, -(z + offset(2)) * size, 1);
+						double distance = edgeDistance(P, distorted ? &lens : nullptr, exact);
+						closest = std::max(closest, distance);
+						beyond += distance > CHECK_EDGE_TOLERANCE;
+					}
+				}
+			}
+		}
+		std::cout << "LOG - Check: " << (distorted ? "distorted" : "undistorted") << " projectVoxel differs from the rows for " << voxel << " voxels, at most "
+			<< closest << " pixels from a pixel edge." << std::endl;
+		if (split > 0 || single > 0 || beyond > 0) {
+			std::cerr << "LOG(ERR) - Check: " << (distorted ? "distorted" : "undistorted") << " rows differ for " << split << " voxels of split rows and "
+				<< single << " single voxels, " << beyond << " voxels of projectVoxel differ further than " << CHECK_EDGE_TOLERANCE << " pixels from a pixel edge." << std::endl;
+			ok = false;
+		}
+	}
+	std::cout << "LOG - Check: row projection " << (ok ? "passed." : "FAILED.") << std::endl;
+	return ok;
+}
+
+bool checkSnapshotInPlace(const std::string& filename) {
+	std::cout << "LOG - Check: snapshot resumed and written to the same file." << std::endl;
+	// a ball with a few colored voxels and a seen half
+	Model model(24, 20, 16, 0.01f);
+	for (int z = 0; z < model.getZ(); z++) {
+		for (int y = 0; y < model.getY(); y++) {
+			for (int x = 0; x < model.getX(); x++) {
+				if ((x - 12) * (x - 12) + (y - 10) * (y - 10) + (z - 8) * (z - 8) > 64) {
+					model.set(x, y, z, Vector4f(0, 0, 0, 0));
+				}
+				else if ((x + y + z) % 3 == 0) {
+					model.set(x, y, z, Vector4f((float)(10 * x), (float)(10 * y), (float)(10 * z), 1));
+				}
+				if (x < 12) {
+					model.see(x, y, z);
+				}
+			}
+		}
+	}
+	// calibration and poses of the applied views, a view without pose like those estimated with another calibration
+	cv::Mat cameraMatrix = cv::Mat::eye(3, 3, CV_64F), distCoeffs = cv::Mat::zeros(1, 5, CV_64F);
+	cameraMatrix.at<double>(0, 0) = cameraMatrix.at<double>(1, 1) = 800;
+	cameraMatrix.at<double>(0, 2) = 320;
+	cameraMatrix.at<double>(1, 2) = 240;
+	distCoeffs.at<double>(0) = -0.1;
+	cv::Mat pose = cv::Mat::eye(3, 4, CV_32F);
+	pose.at<float>(2, 3) = 0.5f;
+	model.setCalibration(cameraMatrix, distCoeffs);
+	model.getAppliedViews().push_back(AppliedView("first.png", pose, cv::Size(640, 480)));
+	model.getAppliedViews().push_back(AppliedView("unposed.png"));
+	if (!model.WriteSnapshot(filename)) {
+		return false;
+	}
+	std::unique_ptr<Model> resumed = Model::ReadSnapshot(filename);
+	if (!resumed) {
+		return false;
+	}
+
+	// carve the lower slices like a further view and write the snapshot over the file the model is mapped from
+	for (int z = 0; z < 4; z++) {
+		for (int y = 0; y < resumed->getY(); y++) {
+			for (int x = 0; x < resumed->getX(); x++) {
+				resumed->set(x, y, z, Vector4f(0, 0, 0, 0));
+				resumed->see(x, y, z);
+			}
+		}
+	}
+	pose.at<float>(0, 3) = 0.25f;
+	resumed->getAppliedViews().push_back(AppliedView("second.png", pose, cv::Size(640, 480)));
+	if (!resumed->WriteSnapshot(filename)) {
+		std::cerr << "LOG(ERR) - Check: the resumed snapshot could not be written in place." << std::endl;
+		return false;
+	}
+
+	// the resumed model is still readable and the new file holds it
+	std::unique_ptr<Model> written = Model::ReadSnapshot(filename);
+	bool ok = written && written->getAppliedViews() == resumed->getAppliedViews() && written->getAppliedViews().size() == 3
+		&& written->getAppliedViews()[0].hasPose && !written->getAppliedViews()[1].hasPose && written->hasCalibration(cameraMatrix, distCoeffs);
+	if (!ok) {
+		std::cerr << "LOG(ERR) - Check: applied views, poses or calibration differ from the resumed model." << std::endl;
+	}
+	for (int z = 0; ok && z < resumed->getZ(); z++) {
+		for (int y = 0; ok && y < resumed->getY(); y++) {
+			for (int x = 0; ok && x < resumed->getX(); x++) {
+				if (written->get(x, y, z) != resumed->get(x, y, z) || written->isSeen(x, y, z) != resumed->isSeen(x, y, z)) {
+					std::cerr << "LOG(ERR) - Check: voxel (" << x << ", " << y << ", " << z << ") differs from the resumed model." << std::endl;
+					ok = false;
+				}
+			}
+		}
+	}
+	std::cout << "LOG - Check: snapshot in place " << (ok ? "passed." : "FAILED.") << std::endl;
+	return ok;
+}
+
+/**
+ * @brief Creates the synthetic scene of the engine checks: views on a ring around the grid looking at its centre, whose masks are ellipses
+ * with a frayed band along their border (so silhouette edges cut through blocks and rows) and whose images have a color per pixel.
+ *
+ * @param distorted		whether the views apply the lens distortion to the projections instead of undistorting the frames
+ * @return ViewSet		prepared views
+ */
+static ViewSet createCheckScene(bool distorted) {
+	const double pi = std::acos(-1.0);
+	cv::Size size(640, 480);
+	cv::Mat cameraMatrix = cv::Mat::eye(3, 3, CV_64F), distCoeffs = cv::Mat::zeros(1, 5, CV_64F);
+	cameraMatrix.at<double>(0, 0) = 561.7;
+	cameraMatrix.at<double>(1, 1) = 562.3;
+	cameraMatrix.at<double>(0, 2) = 321.8;
+	cameraMatrix.at<double>(1, 2) = 240.6;
+	if (distorted) {
+		distCoeffs.at<double>(0) = -0.08;
+		distCoeffs.at<double>(1) = 0.03;
+		distCoeffs.at<double>(2) = 5e-4;
+		distCoeffs.at<double>(3) = -3e-4;
+	}
+	ViewSet views(cameraMatrix, distCoeffs, distorted);
+	for (int i = 0; i < CHECK_VIEWS; i++) {
+		// camera centre on a tilted ring, looking at the world origin (rows of the rotation: right, down, forward)
+		double angle = 2 * pi * i / CHECK_VIEWS;
+		double center[3] = { 1.1 * std::cos(angle), 1.1 * std::sin(angle), 0.35 * std::sin(3 * angle + 0.4) };
+		double norm = std::sqrt(center[0] * center[0] + center[1] * center[1] + center[2] * center[2]), across = std::hypot(center[0], center[1]);
+		double axes[3][3] = {
+			{ -center[1] / across, center[0] / across, 0 },
+			{ 0, 0, 0 },
+			{ -center[0] / norm, -center[1] / norm, -center[2] / norm } };
+		for (int c = 0; c < 3; c++) {
+			axes[1][c] = axes[2][(c + 1) % 3] * axes[0][(c + 2) % 3] - axes[2][(c + 2) % 3] * axes[0][(c + 1) % 3];
+		}
+		cv::Mat pose(3, 4, CV_32F);
+		for (int r = 0; r < 3; r++) {
+			for (int c = 0; c < 3; c++) {
+				pose.at<float>(r, c) = (float)axes[r][c];
+			}
+			pose.at<float>(r, 3) = (float)-(axes[r][0] * center[0] + axes[r][1] * center[1] + axes[r][2] * center[2]);
+		}
+		views.addView(pose, size);
+
+		cv::Mat image(size, CV_8UC3), mask(size, CV_8UC3);
+		double ax = 95 + 9 * i, ay = 70 + 5 * (i % 3);
+		for (int y = 0; y < size.height; y++) {
+			for (int x = 0; x < size.width; x++) {
+				double dx = (x - 321.8 - 4 * i) / ax, dy = (y - 240.6 + 3 * i) / ay, r = std::sqrt(dx * dx + dy * dy);
+				unsigned hash = (unsigned)(x * 73856093) ^ (unsigned)(y * 19349663) ^ (unsigned)(i * 83492791);
+				bool foreground = r < 0.95 || (r < 1.05 && hash % 3 != 0);
+				mask.at<cv::Vec3b>(y, x) = foreground ? cv::Vec3b(255, 255, 255) : cv::Vec3b(0, 0, 0);
+				image.at<cv::Vec3b>(y, x) = cv::Vec3b((uchar)(7 * x + 31 * i), (uchar)(5 * y), (uchar)(3 * (x + y) + i));
+			}
+		}
+		views.setFrames(i, image, mask);
+	}
+	return views;
+}
+
+/**
+ * @brief Model over the grid of the engine checks, centred at the world origin.
+ */
+static std::unique_ptr<Model> createCheckModel(ModelStorage storage = ModelStorage::Dense, VoxelLayout layout = VoxelLayout::Linear) {
+	int offset = -CHECK_ENGINE_GRID / 2;
+	return std::unique_ptr<Model>(new Model(CHECK_ENGINE_GRID, CHECK_ENGINE_GRID, CHECK_ENGINE_GRID, 0.6f / CHECK_ENGINE_GRID, storage, cv::Vec3i(offset, offset, offset), layout));
+}
+
+/**
+ * @brief Compares a model with the reference model, logs the first difference.
+ *
+ * @param name			name of the engine or storage in the log
+ * @param reference		model of the standard method
+ * @param model			model to compare
+ * @param superset		whether the model may keep voxels the reference carved
+ * @param seen			whether the seen voxels have to match as well
+ * @param colors		whether the colors of the surface voxels have to match as well (up to the rounding of 8 bit storages)
+ * @param tolerated		voxels whose occupancy may differ from the reference, nullptr if none may
+ * @return bool			whether the models match
+ */
+static bool compareModels(const std::string& name, Model& reference, Model& model, bool superset, bool seen, bool colors,
+	const std::function<bool(int, int, int)>& tolerated = nullptr) {
+	long occupancy = 0, unseen = 0, color = 0, near = 0;
+	std::string first;
+	auto note = [&](const std::string& what, int x, int y, int z) {
+		if (first.empty()) {
+			first = what + " of voxel (" + std::to_string(x) + ", " + std::to_string(y) + ", " + std::to_string(z) + ")";
+		}
+	};
+	for (int z = 0; z < CHECK_ENGINE_GRID; z++) {
+		for (int y = 0; y < CHECK_ENGINE_GRID; y++) {
+			for (int x = 0; x < CHECK_ENGINE_GRID; x++) {
+				bool occupied = reference.isOccupied(x, y, z);
+				if (model.isOccupied(x, y, z) != occupied && !(superset && !occupied)) {
+					if (tolerated && tolerated(x, y, z)) {
+						near++;
+					}
+					else {
+						occupancy++;
+						note("occupancy", x, y, z);
+					}
+				}
+				if (seen && model.isSeen(x, y, z) != reference.isSeen(x, y, z)) {
+					unseen++;
+					note("seen", x, y, z);
+				}
+				if (colors && occupied && !reference.isInner(x, y, z) && model.isOccupied(x, y, z)) {
+					Vector4f a = reference.get(x, y, z), b = model.get(x, y, z);
+					if (std::fabs(a(0) - b(0)) > 0.51f || std::fabs(a(1) - b(1)) > 0.51f || std::fabs(a(2) - b(2)) > 0.51f) {
+						color++;
+						note("color", x, y, z);
+					}
+				}
+			}
+		}
+	}
+	if (near > 0) {
+		std::cout << "LOG - Check: " << name << " differs for " << near << " voxels within " << CHECK_EDGE_TOLERANCE << " pixels of a pixel edge." << std::endl;
+	}
+	if (occupancy > 0 || unseen > 0 || color > 0) {
+		std::cerr << "LOG(ERR) - Check: " << name << " differs from the standard method in " << occupancy << " occupied, " << unseen << " seen and "
+			<< color << " colored voxels, first in the " << first << "." << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool checkCarvingEngines() {
+	std::cout << "LOG - Check: carving engines, storages and layouts against the standard method on a synthetic " << CHECK_ENGINE_GRID << "^3 scene." << std::endl;
+	const ModelStorage storages[] = { ModelStorage::Dense, ModelStorage::Compact, ModelStorage::RGBA8 };
+	const char* storageNames[] = { "dense", "compact", "rgba8" };
+	const VoxelLayout layouts[] = { VoxelLayout::Linear, VoxelLayout::Bricked, VoxelLayout::Padded };
+	const char* layoutNames[] = { "linear", "bricked", "padded" };
+
+	bool ok = true;
+	for (int distorted = 0; distorted < 2; distorted++) {
+		ViewSet views = createCheckScene(distorted != 0);
+		std::string scene = distorted ? "distorted " : "";
+		std::unique_ptr<Model> reference = createCheckModel();
+		carve(views, *reference);
+		reconstructAvgColor(views, *reference);
+
+		// engines (--carve=1..7), with the default storage
+		auto engine = [&](const std::string& name, const std::function<void(Model&)>& run, bool superset, bool seen, bool colors,
+			const std::function<bool(int, int, int)>& tolerated = nullptr) {
+			std::unique_ptr<Model> model = createCheckModel();
+			run(*model);
+			ok = compareModels(scene + name, *reference, *model, superset, seen, colors, tolerated) && ok;
+		};
+		engine("fused carving", [&](Model& model) { carveAndReconstructColor(views, model, 2); }, false, true, true);
+		// greedy carving only tests the voxels connected to the carved region and does not mark voxels as seen
+		engine("greedy carving", [&](Model& model) { fastCarve(views, model); }, true, false, false);
+		engine("hierarchical carving", [&](Model& model) { hierarchicalCarve(views, model); }, false, true, false);
+		engine("survivor carving", [&](Model& model) { survivorCarve(views, model); }, false, true, false);
+		engine("ordered survivor carving", [&](Model& model) { survivorCarve(views, model, true); }, false, true, false);
+		engine("column carving", [&](Model& model) { columnCarve(views, model); }, false, true, false);
+		// the slices of undistorted views are warped by a homography in double precision, which may round voxels on pixel edges differently
+		auto nearEdge = [&](int x, int y, int z) {
+			cv::Vec3i offset = reference->getOffset();
+			double size = reference->getSize();
+			cv::Vec4d exact((y + offset(1)) * size, (x + offset(0)) * size, -(z + offset(2)) * size, 1);
+			for (CameraView& view : views) {
+				if (edgeDistance(view.projection, nullptr, exact) <= CHECK_EDGE_TOLERANCE) {
+					return true;
+				}
+			}
+			return false;
+		};
+		engine("slice carving", [&](Model& model) { sliceCarve(views, model); }, false, true, false, distorted ? nullptr : std::function<bool(int, int, int)>(nearEdge));
+		engine("ray carving", [&](Model& model) { rayCarve(views, model, 2); }, true, true, false);
+
+		// storages and layouts, with separate and fused coloring
+		for (int s = 0; s < 3; s++) {
+			for (int l = 0; l < 3; l++) {
+				std::string name = std::string(storageNames[s]) + " " + layoutNames[l];
+				std::unique_ptr<Model> model = createCheckModel(storages[s], layouts[l]);
+				carve(views, *model);
+				reconstructAvgColor(views, *model);
+				ok = compareModels(scene + name + " model", *reference, *model, false, true, true) && ok;
+
+				model = createCheckModel(storages[s], layouts[l]);
+				carveAndReconstructColor(views, *model, 2);
+				ok = compareModels(scene + "fused " + name + " model", *reference, *model, false, true, true) && ok;
+			}
+		}
+		std::unique_ptr<Model> sparse = createCheckModel(ModelStorage::Sparse);
+		carve(views, *sparse);
+		reconstructAvgColor(views, *sparse);
+		ok = compareModels(scene + "sparse model", *reference, *sparse, false, true, true) && ok;
+	}
+	std::cout << "LOG - Check: carving engines " << (ok ? "passed." : "FAILED.") << std::endl;
+	return ok;
+}
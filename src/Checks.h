@@ -0,0 +1,43 @@
+#pragma once
+
+#ifndef CHECKS_H
+#define CHECKS_H
+
+#include <string>
+
+/**
+ * @brief Compares the packed projection kernels (AVX2/SSE2) with the portable ones on rows that hit their edge cases:
+ * points on the camera plane (w or Z close to 0), coordinates beyond the int range, NaN, halfway cases and points beyond the valid lens radius.
+ *
+ * @return bool		whether both kernels give the same pixels for every point
+ */
+bool checkProjectionKernels();
+
+/**
+ * @brief Projects every voxel of a grid in front of a real camera (with and without lens distortion) as whole rows, as rows split at a voxel
+ * and as single points of their rows, which have to give the same pixels. Voxels projected by projectVoxel (from their centre instead of
+ * stepping along the row) may only differ where their exact projection lies on a pixel edge (within CHECK_EDGE_TOLERANCE pixels).
+ *
+ * @return bool		whether the projections match
+ */
+bool checkRowProjection();
+
+/**
+ * @brief Carves a synthetic scene (with and without distorted projections) with every engine (--carve), every storage and layout and
+ * the fused coloring, then compares occupancy, seen voxels and surface colors with the standard method (dense, linear, separate coloring).
+ * Greedy and ray carving may keep voxels the standard method carves, slice carving may differ for voxels on pixel edges of undistorted views.
+ *
+ * @return bool		whether every model matches the standard one
+ */
+bool checkCarvingEngines();
+
+/**
+ * @brief Writes a snapshot of a small model, resumes it, carves further voxels and writes the snapshot again to the file it is mapped from
+ * (-resume=X -snapshot=X), then compares the result with the resumed model, including the calibration and the poses of the applied views.
+ *
+ * @param filename	path of the snapshot file, it is overwritten
+ * @return bool		whether the snapshot could be written in place and holds the resumed model
+ */
+bool checkSnapshotInPlace(const std::string& filename);
+
+#endif
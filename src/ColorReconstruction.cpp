@@ -1,70 +1,68 @@
 #pragma once
 
 #include "ColorReconstruction.h"
-#include "aruco_samples_utility.hpp"
-#include "PoseEstimation.h"
+#include "VoxelPass.h"
 #include "Segmentation.h"
 #include "Benchmark.h"
 
-/**
- * @brief This function performs a projection from world to camera coordinates.
- *
- * @param world         homogeneous world coordinates
- * @param pose          pose transformation
- * @param intr          camera intrinsics
- * @return cv::Vec3f    homogeneous camera coordinates
- */
-static cv::Vec3f worldToCamera(cv::Vec4f world, cv::Mat& pose, cv::Mat& intr) {
-    cv::Mat1f proj = intr * pose * world;
-    return cv::Vec3f(proj(0) / proj(2), proj(1) / proj(2), 1);
+void reconstructClosestColor(ViewSet& views, Model& model) {
+    std::cout << "LOG - CR: starting color reconstruction (closest color)." << std::endl;
+    Benchmark::GetInstance().LogColoring(true);
+    VoxelPass<KeepOccupancy, ClosestColor>::run(views, model);
+    Benchmark::GetInstance().LogColoring(false);
+    std::cout << "LOG - CR: color reconstruction finished." << std::endl;
 }
 
-void reconstructClosestColor(cv::Mat& cameraMatrix, cv::Mat& distCoeffs, Model& model, std::vector<cv::Mat>& images, std::vector<cv::Mat>& masks) {
-    std::cout << "LOG - CR: starting color reconstruction (closest color)." << std::endl;
+void reconstructAvgColor(ViewSet& views, Model& model) {
+    std::cout << "LOG - CR: starting color reconstruction (average color)." << std::endl;
     Benchmark::GetInstance().LogColoring(true);
-    int x = 0, y = 0, z = 0;
-    voxel_pass(x, y, z, cameraMatrix, distCoeffs, model, images, masks)
-    {
-        std::vector<DCLR> colors = model.getColors(x, y, z);
-        if (colors.size() == 0) {
-            continue;
-        }
+    VoxelPass<KeepOccupancy, AverageColor>::run(views, model);
+    Benchmark::GetInstance().LogColoring(false);
+    std::cout << "LOG - CR: color reconstruction finished." << std::endl;
+}
 
-        // find color with min depth
-        DCLR min = colors[0];
-        for (int i = 1; i < colors.size(); i++) {
-            if (colors[i].depth < min.depth)
-            {
-                min = colors[i];
-            }
-        }
-        model.set(x, y, z, min.color);
+void carveAndReconstructColor(ViewSet& views, Model& model, int color) {
+    std::cout << "LOG - VC: starting fused carving and color reconstruction (" << ThreadPool::GetInstance().GetThreadCount() << " threads)." << std::endl;
+    Benchmark::GetInstance().LogCarving(true);
+    if (color == 1) {
+        VoxelPass<CentreCarve, ClosestColor>::run(views, model);
+    }
+    else {
+        VoxelPass<CentreCarve, AverageColor>::run(views, model);
+    }
+    Benchmark::GetInstance().LogCarving(false);
+    std::cout << "LOG - VC: carving and color reconstruction complete." << std::endl;
+}
 
+void reconstructColor(ViewSet& views, Model& model, int color, const std::vector<cv::Vec3i>& voxels) {
+    std::cout << "LOG - CR: starting color reconstruction of " << voxels.size() << " voxels." << std::endl;
+    Benchmark::GetInstance().LogColoring(true);
+    if (color == 1) {
+        VoxelPass<KeepOccupancy, ClosestColor>::colorVoxels(views, model, voxels);
+    }
+    else {
+        VoxelPass<KeepOccupancy, AverageColor>::colorVoxels(views, model, voxels);
     }
     Benchmark::GetInstance().LogColoring(false);
     std::cout << "LOG - CR: color reconstruction finished." << std::endl;
 }
 
-void reconstructAvgColor(cv::Mat& cameraMatrix, cv::Mat& distCoeffs, Model& model, std::vector<cv::Mat>& images, std::vector<cv::Mat>& masks) {
-    std::cout << "LOG - CR: starting color reconstruction (average color)." << std::endl;
-    Benchmark::GetInstance().LogColoring(true);
-    int x = 0, y = 0, z = 0;
-    voxel_pass(x, y, z, cameraMatrix, distCoeffs, model, images, masks)
-    {
-        std::vector<DCLR> colors = model.getColors(x, y, z);
-        if (colors.size() == 0) {
-            continue;
+std::vector<int> viewsSeeing(ViewSet& views, Model& model, const std::vector<cv::Vec3i>& voxels) {
+    std::vector<char> sees(views.size());
+    cv::Vec4f x_step = model.rowStep();
+    ThreadPool::GetInstance().ParallelFor(0, views.size(), [&](int begin, int end) {
+        for (int v = begin; v < end; v++) {
+            for (size_t i = 0; i < voxels.size() && !sees[v]; i++) {
+                // same pixels as the color reconstruction
+                sees[v] = views[v].projectRowPoint(model.rowStart(voxels[i](1), voxels[i](2)), x_step, model.rowPoint(voxels[i](0))).inside(views[v].borders);
+            }
         }
-
-        // calculate average color value
-        Vector4f sum = Vector4f(0, 0, 0, 1);
-        for (DCLR& c : colors)
-        {
-            sum = sum + c.color;
+    });
+    std::vector<int> seeing;
+    for (int v = 0; v < views.size(); v++) {
+        if (sees[v]) {
+            seeing.push_back(v);
         }
-        Vector4f avg = sum / colors.size();
-        model.set(x, y, z, Vector4f(std::round(avg.x()), std::round(avg.y()), std::round(avg.z()), 1));
     }
-    Benchmark::GetInstance().LogColoring(false);
-    std::cout << "LOG - CR: color reconstruction finished." << std::endl;
+    return seeing;
 }
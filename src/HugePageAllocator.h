@@ -0,0 +1,90 @@
+#pragma once
+
+#ifndef HUGE_PAGE_ALLOCATOR_H
+#define HUGE_PAGE_ALLOCATOR_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <utility>
+#include <vector>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+// size of a transparent huge page, allocations of at least this many bytes are aligned to and backed by huge pages where available
+#define HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+/**
+ * @brief Allocator for the large per-voxel and mesh arrays. Allocations of at least HUGE_PAGE_SIZE bytes are aligned to huge pages and
+ * on Linux advised as transparent huge pages, which saves most page faults and TLB misses on grids of several GB.
+ * Smaller allocations use operator new.
+ * Resizing a vector without a value default-initialises its elements (trivial types are left untouched), so the memory is first touched
+ * by whoever fills it afterwards (see Model::fillParallel) instead of by the thread that allocates it.
+ */
+template <class T>
+class HugePageAllocator {
+public:
+	using value_type = T;
+
+	HugePageAllocator() = default;
+	template <class U>
+	HugePageAllocator(const HugePageAllocator<U>&) {}
+
+	T* allocate(size_t n) {
+		size_t bytes = n * sizeof(T);
+		if (bytes < HUGE_PAGE_SIZE) {
+			return static_cast<T*>(::operator new(bytes));
+		}
+		size_t rounded = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+#ifdef _WIN32
+		void* p = _aligned_malloc(rounded, HUGE_PAGE_SIZE);
+#else
+		void* p = std::aligned_alloc(HUGE_PAGE_SIZE, rounded);
+#endif
+		if (!p) {
+			throw std::bad_alloc();
+		}
+#ifdef MADV_HUGEPAGE
+		// only a hint, the kernel falls back to normal pages if THP is disabled
+		madvise(p, rounded, MADV_HUGEPAGE);
+#endif
+		return static_cast<T*>(p);
+	}
+
+	void deallocate(T* p, size_t n) {
+		if (n * sizeof(T) < HUGE_PAGE_SIZE) {
+			::operator delete(p);
+			return;
+		}
+#ifdef _WIN32
+		_aligned_free(p);
+#else
+		std::free(p);
+#endif
+	}
+
+	template <class U>
+	void construct(U* p) {
+		::new ((void*)p) U;
+	}
+
+	template <class U, class... Args>
+	void construct(U* p, Args&&... args) {
+		::new ((void*)p) U(std::forward<Args>(args)...);
+	}
+};
+
+template <class T, class U>
+bool operator==(const HugePageAllocator<T>&, const HugePageAllocator<U>&) { return true; }
+
+template <class T, class U>
+bool operator!=(const HugePageAllocator<T>&, const HugePageAllocator<U>&) { return false; }
+
+template <class T>
+using HugePageVector = std::vector<T, HugePageAllocator<T>>;
+
+#endif
@@ -0,0 +1,148 @@
+#include <iostream>
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& filename, size_t size) : length(size) {
+	HANDLE handle = CreateFileA(filename.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle == INVALID_HANDLE_VALUE) {
+		std::cerr << "LOG(ERR) - MF: could not create file " << filename << "." << std::endl;
+		return;
+	}
+	file = handle;
+	// the mapping extends the file to its size, new bytes are 0
+	fileMapping = CreateFileMappingA(handle, nullptr, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)(size & 0xFFFFFFFF), nullptr);
+	if (!fileMapping) {
+		std::cerr << "LOG(ERR) - MF: could not map file " << filename << "." << std::endl;
+		return;
+	}
+	mapping = (uint8_t*)MapViewOfFile(fileMapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	if (!mapping) {
+		std::cerr << "LOG(ERR) - MF: could not map file " << filename << "." << std::endl;
+	}
+}
+
+MappedFile::MappedFile(const std::string& filename) {
+	HANDLE handle = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (handle == INVALID_HANDLE_VALUE) {
+		std::cerr << "LOG(ERR) - MF: could not open file " << filename << "." << std::endl;
+		return;
+	}
+	file = handle;
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart == 0) {
+		std::cerr << "LOG(ERR) - MF: could not map empty file " << filename << "." << std::endl;
+		return;
+	}
+	length = (size_t)fileSize.QuadPart;
+	fileMapping = CreateFileMappingA(handle, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+	if (!fileMapping) {
+		std::cerr << "LOG(ERR) - MF: could not map file " << filename << "." << std::endl;
+		return;
+	}
+	mapping = (uint8_t*)MapViewOfFile(fileMapping, FILE_MAP_COPY, 0, 0, length);
+	if (!mapping) {
+		std::cerr << "LOG(ERR) - MF: could not map file " << filename << "." << std::endl;
+	}
+}
+
+MappedFile::~MappedFile() {
+	if (mapping) {
+		UnmapViewOfFile(mapping);
+	}
+	if (fileMapping) {
+		CloseHandle(fileMapping);
+	}
+	if (file) {
+		CloseHandle(file);
+	}
+}
+
+void MappedFile::release(size_t begin, size_t count) {
+	if (!mapping || count == 0) {
+		return;
+	}
+	FlushViewOfFile(mapping + begin, count);
+	// unlocking pages that are not locked removes them from the working set
+	VirtualUnlock(mapping + begin, count);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& filename, size_t size) : length(size) {
+	file = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (file < 0) {
+		std::cerr << "LOG(ERR) - MF: could not create file " << filename << "." << std::endl;
+		return;
+	}
+	// the file is sparse, blocks are only allocated when pages are written
+	if (ftruncate(file, (off_t)size) != 0) {
+		std::cerr << "LOG(ERR) - MF: could not resize file " << filename << "." << std::endl;
+		return;
+	}
+	void* address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	if (address == MAP_FAILED) {
+		std::cerr << "LOG(ERR) - MF: could not map file " << filename << "." << std::endl;
+		return;
+	}
+	mapping = (uint8_t*)address;
+}
+
+MappedFile::MappedFile(const std::string& filename) {
+	file = open(filename.c_str(), O_RDONLY);
+	if (file < 0) {
+		std::cerr << "LOG(ERR) - MF: could not open file " << filename << "." << std::endl;
+		return;
+	}
+	struct stat status;
+	if (fstat(file, &status) != 0 || status.st_size == 0) {
+		std::cerr << "LOG(ERR) - MF: could not map empty file " << filename << "." << std::endl;
+		return;
+	}
+	length = (size_t)status.st_size;
+	// private mappings can be written, written pages are copied and never reach the file
+	void* address = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+	if (address == MAP_FAILED) {
+		std::cerr << "LOG(ERR) - MF: could not map file " << filename << "." << std::endl;
+		return;
+	}
+	mapping = (uint8_t*)address;
+}
+
+MappedFile::~MappedFile() {
+	if (mapping) {
+		munmap(mapping, length);
+	}
+	if (file >= 0) {
+		close(file);
+	}
+}
+
+void MappedFile::release(size_t begin, size_t count) {
+	if (!mapping || count == 0) {
+		return;
+	}
+	// both calls work on whole pages, only pages that lie completely within the range are dropped
+	size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	size_t first = (begin + page - 1) / page * page;
+	size_t last = (begin + count) / page * page;
+	if (first >= last) {
+		return;
+	}
+	msync(mapping + first, last - first, MS_ASYNC);
+	// pages of shared file mappings are kept in the page cache, so nothing is lost
+	madvise(mapping + first, last - first, MADV_DONTNEED);
+}
+
+#endif
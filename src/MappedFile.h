@@ -0,0 +1,61 @@
+#pragma once
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief File of a fixed size that is mapped into memory for reading and writing.
+ * Pages are loaded on first access and written back by the operating system, so data larger than the available memory
+ * can be addressed like an array. Pages that are not needed anymore can be handed back with release().
+ * Mapping an existing file only reserves the address range, so it takes constant time regardless of the size of the file.
+ */
+class MappedFile {
+private:
+	uint8_t* mapping = nullptr;
+	size_t length = 0;
+#ifdef _WIN32
+	void* file = nullptr;
+	void* fileMapping = nullptr;
+#else
+	int file = -1;
+#endif
+
+public:
+	/**
+	 * @brief Creates (or truncates) the file with the given size and maps it, all bytes are 0 afterwards.
+	 *
+	 * @param filename	path of the file
+	 * @param size		size of the file in bytes
+	 */
+	MappedFile(const std::string& filename, size_t size);
+
+	/**
+	 * @brief Maps an existing file copy-on-write: it can be written in memory, but changes are never written back to the file.
+	 *
+	 * @param filename	path of the file
+	 */
+	MappedFile(const std::string& filename);
+	~MappedFile();
+
+	MappedFile(MappedFile const&) = delete;
+	void operator=(MappedFile const&) = delete;
+
+	bool isOpen() { return mapping != nullptr; }
+	uint8_t* data() { return mapping; }
+	size_t size() { return length; }
+
+	/**
+	 * @brief Writes the given range back to the file and removes its pages from the memory of the process.
+	 * The data stays valid, the pages are read again from the file on the next access. Only for created files, changes of copy-on-write mappings would be lost.
+	 *
+	 * @param begin		first byte of the range
+	 * @param count		number of bytes
+	 */
+	void release(size_t begin, size_t count);
+};
+
+#endif
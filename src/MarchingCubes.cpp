@@ -5,21 +5,34 @@
 #include "MarchingCubes.h"
 #include "Benchmark.h"
 
+void marchCells(Model* model, cv::Vec3i begin, cv::Vec3i end, SimpleMesh* mesh, float threshold) {
+	// storage and layout are resolved once for all cells, x is the innermost loop, consecutive cells share seven of their corners in memory order
+	dispatchVoxelAccess(*model, [&](auto& grid) {
+		for (int z = begin(2); z < end(2); z++) {
+			for (int y = begin(1); y < end(1); y++) {
+				for (int x = begin(0); x < end(0); x++) {
+					ProcessVoxel(&grid, x, y, z, mesh, threshold);
+				}
+			}
+		}
+	});
+}
+
 bool marchingCubes(Model* model, float scale, Vector3f translation, float threshold, std::string outFileName) {
 	std::cout << "LOG - MC: starting to process Voxels." << std::endl;
 	Benchmark::GetInstance().LogMarchingCubes(true);
 	SimpleMesh mesh;
-	for (int x = -1; x < model->getX(); x++) {
-		for (int y = -1; y < model->getY(); y++) {
-			for (int z = -1; z < model->getZ(); z++) {
-				ProcessVoxel(model, x, y, z, &mesh, threshold);
-			}
-		}
+	// cells have their first corner in a brick or its neighbours before it, cells before the grid belong to the first bricks
+	for (const cv::Vec3i& brick : model->getBricks(1)) {
+		cv::Vec3i begin(brick(0) == 0 ? -1 : brick(0), brick(1) == 0 ? -1 : brick(1), brick(2) == 0 ? -1 : brick(2));
+		marchCells(model, begin, model->brickEnd(brick), &mesh, threshold);
 	}
 	Benchmark::GetInstance().LogMarchingCubes(false);
 	std::cout << "LOG - MC: voxel processing completed.\n Writing mesh..." << std::endl;
 
-	// write mesh to file
+	// write mesh to file, grids with an offset are moved to their place in the scene
+	cv::Vec3i offset = model->getOffset();
+	translation += scale * model->getSize() * Vector3f((float)offset(0), (float)offset(1), (float)offset(2));
 	if (!mesh.WriteMesh(outFileName, scale * model->getSize(), translation)) {
 		std::cout << "ERR - MC: unable to write output file!" << std::endl;
 		return false;
@@ -8,6 +8,7 @@
 #include<fstream>
 
 #include "Model.h"
+#include "HugePageAllocator.h"
 
 using Eigen::Vector3f;
 
@@ -47,12 +48,12 @@ public:
 		return fId;
 	}
 
-	std::vector<Vector3f>& GetVertices()
+	HugePageVector<Vector3f>& GetVertices()
 	{
 		return m_vertices;
 	}
 
-	std::vector<Triangle>& GetTriangles()
+	HugePageVector<Triangle>& GetTriangles()
 	{
 		return m_triangles;
 	}
@@ -87,14 +88,17 @@ public:
 	}
 
 private:
-	std::vector<Vector3f> m_vertices;
-	std::vector<Triangle> m_triangles;
+	// meshes of large grids reach hundreds of MB, so they are backed by huge pages like the voxels
+	HugePageVector<Vector3f> m_vertices;
+	HugePageVector<Triangle> m_triangles;
 };
 
 struct MC_Gridcell {
 	EIGEN_MAKE_ALIGNED_OPERATOR_NEW
 		Vector4f val[8];
 	Vector3f p[8];
+	float density[8];	// value compared to the threshold, alpha or fractional coverage
+	bool fractional;	// whether density holds fractional coverage
 };
 
 struct MC_Triangle {
@@ -416,38 +420,43 @@ static unsigned int MeanColorFloats(float c1, float c2, float c3) {
 }
 
 /**
-* @brief Interpolates the given points and colors based on a threshold
+* @brief Interpolates the given points and colors of a cell edge based on a threshold
 *
 * @param threshold			interpolation threshold
-* @param point0				coordinates of first point
-* @param val0				color of first point
-* @param point1				coordinates of second point
-* @param val1				color of second point
+* @param cell				cell the edge belongs to
+* @param i0					index of the first point of the edge
+* @param i1					index of the second point of the edge
 * @return MC_Interpolate	interpolated coordinates and color
 */
-static MC_Interpolate VertexInterp(float threshold, const Vector3f& point0, const Vector4f& val0, const Vector3f& point1, const Vector4f& val1) {
+static MC_Interpolate VertexInterp(float threshold, const MC_Gridcell& cell, int i0, int i1) {
 	MC_Interpolate ret;
+	const Vector3f& point0 = cell.p[i0];
+	const Vector3f& point1 = cell.p[i1];
+	const Vector4f& val0 = cell.val[i0];
+	const Vector4f& val1 = cell.val[i1];
 
-	// ignore points that don't belong to the model (w == 0.0f)
+	float interpolateFactor;
+	if (cell.density[i0] == cell.density[i1]) {
+		interpolateFactor = 0.5f;
+	}
+	else {
+		interpolateFactor = (threshold - cell.density[i0]) / (cell.density[i1] - cell.density[i0]);
+	}
+	Vector3f interpolated = (1 - interpolateFactor) * point0 + interpolateFactor * point1;
+
+	// ignore points that don't belong to the model (w == 0.0f), without coverage the surface snaps to the model point
 	if (val0.w() == 0.0f && val1.w() != 0.0f) {
 		ret.color = Vector3f(val1.x(), val1.y(), val1.z());
-		ret.coord = point1;
+		ret.coord = cell.fractional ? interpolated : point1;
 		return ret;
 	}
 	else if (val0.w() != 0.0f && val1.w() == 0.0f) {
 		ret.color = Vector3f(val0.x(), val0.y(), val0.z());
-		ret.coord = point0;
+		ret.coord = cell.fractional ? interpolated : point0;
 		return ret;
 	}
 
-	float interpolateFactor;
-	if (val0.w() == val1.w()) {
-		interpolateFactor = 0.5f;
-	}
-	else {
-		interpolateFactor = (threshold - val0.w()) / (val1.w() - val0.w());
-	}
-	ret.coord = (1 - interpolateFactor) * point0 + interpolateFactor * point1;
+	ret.coord = interpolated;
 	Vector3f col0 = Vector3f(val0.x(), val0.y(), val0.z());
 	Vector3f col1 = Vector3f(val1.x(), val1.y(), val1.z());
 
@@ -478,7 +487,7 @@ static MC_Interpolate VertexInterp(float threshold, const Vector3f& point0, cons
 static int Polygonise(const MC_Gridcell& cell, float threshold, MC_Triangle* triangles) {
 	int cubeIdx = 0;
 	for (int i = 0; i < 8; i++) {
-		if (cell.val[i].w() < threshold) {
+		if (cell.density[i] < threshold) {
 			cubeIdx |= 1 << i;
 		}
 	}
@@ -492,7 +501,7 @@ static int Polygonise(const MC_Gridcell& cell, float threshold, MC_Triangle* tri
 
 	for (int i = 0; i < 12; i++) {
 		if (edgeTable[cubeIdx] & (1 << i)) {
-			vertList[i] = VertexInterp(threshold, cell.p[i % 8], cell.val[i % 8], cell.p[secondPointIdices[i]], cell.val[secondPointIdices[i]]);
+			vertList[i] = VertexInterp(threshold, cell, i % 8, secondPointIdices[i]);
 		}
 	}
 
@@ -521,7 +530,7 @@ static int Polygonise(const MC_Gridcell& cell, float threshold, MC_Triangle* tri
 /**
 * @brief This function processes a single voxel of the model to convert it into a mesh
 *
-* @param model		the model
+* @param model		the model (Model or VoxelAccess)
 * @param x			x-coordinate of voxel base point in the model
 * @param y			y-coordinate of voxel base point in the model
 * @param z			z-coordinate of voxel base point in the model
@@ -529,28 +538,40 @@ static int Polygonise(const MC_Gridcell& cell, float threshold, MC_Triangle* tri
 * @param threshold	threshold for voxel processing
 * @return bool		whether one or more triangles have been created or not
 */
-static bool ProcessVoxel(Model* model, int x, int y, int z, SimpleMesh* mesh, float threshold) {
+template <class Grid>
+static bool ProcessVoxel(Grid* model, int x, int y, int z, SimpleMesh* mesh, float threshold) {
 
 	MC_Gridcell cell;
 
-	// cell corners+values
-	cell.val[0] = model->get(x + 1, y, z);
+	// cell corners+values, cells of the border of the grid have corners in the ghost layer of padded models
+	cell.val[0] = model->getNear(x + 1, y, z);
 	cell.p[0] = Vector3f(x + 1, y, z);
-	cell.val[1] = model->get(x, y, z);
+	cell.val[1] = model->getNear(x, y, z);
 	cell.p[1] = Vector3f(x, y, z);
-	cell.val[2] = model->get(x, y + 1, z);
+	cell.val[2] = model->getNear(x, y + 1, z);
 	cell.p[2] = Vector3f(x, y + 1, z);
-	cell.val[3] = model->get(x + 1, y + 1, z);
+	cell.val[3] = model->getNear(x + 1, y + 1, z);
 	cell.p[3] = Vector3f(x + 1, y + 1, z);
-	cell.val[4] = model->get(x + 1, y, z + 1);
+	cell.val[4] = model->getNear(x + 1, y, z + 1);
 	cell.p[4] = Vector3f(x + 1, y, z + 1);
-	cell.val[5] = model->get(x, y, z + 1);
+	cell.val[5] = model->getNear(x, y, z + 1);
 	cell.p[5] = Vector3f(x, y, z + 1);
-	cell.val[6] = model->get(x, y + 1, z + 1);
+	cell.val[6] = model->getNear(x, y + 1, z + 1);
 	cell.p[6] = Vector3f(x, y + 1, z + 1);
-	cell.val[7] = model->get(x + 1, y + 1, z + 1);
+	cell.val[7] = model->getNear(x + 1, y + 1, z + 1);
 	cell.p[7] = Vector3f(x + 1, y + 1, z + 1);
 
+	// the coverage only moves the surface between a voxel of the model and a carved one,
+	// it is clamped to the side of the threshold given by the occupancy so the topology (and the colors) stay the same
+	cell.fractional = model->hasCoverage();
+	for (int i = 0; i < 8; i++) {
+		cell.density[i] = cell.val[i].w();
+		if (cell.fractional) {
+			float coverage = model->getCoverage((int)cell.p[i].x(), (int)cell.p[i].y(), (int)cell.p[i].z());
+			cell.density[i] = cell.val[i].w() != 0 ? std::max(coverage, threshold) : std::min(coverage, std::nextafter(threshold, 0.f));
+		}
+	}
+
 	MC_Triangle tris[6];
 	int numTris = Polygonise(cell, threshold, tris);
 
@@ -595,4 +616,16 @@ static bool ProcessVoxel(Model* model, int x, int y, int z, SimpleMesh* mesh, fl
 */
 bool marchingCubes(Model* model, float scale = 1.0f, Vector3f translation = Vector3f(0, 0, 0), float threshold = 0.5f, std::string outFileName = "out/mesh.off");
 
+/**
+* @brief This function converts the cells of the model with their first corner in [begin, end) into triangles, in model coordinates.
+* Cells start at voxel -1, so the cells in front of the grid are included with begin = -1.
+*
+* @param model			the model to be processed
+* @param begin			first corner of the first cell
+* @param end			first corner behind the last cell
+* @param mesh			mesh the triangles are added to
+* @param threshold		threshold determining down to what w()-value a point will be considered part of the model
+*/
+void marchCells(Model* model, cv::Vec3i begin, cv::Vec3i end, SimpleMesh* mesh, float threshold = 0.5f);
+
 #endif
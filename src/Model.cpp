@@ -1,20 +1,255 @@
 #include<iostream>
 #include<sstream>
 #include<fstream>
+#include<cstring>
+#include<filesystem>
 #include<Eigen/Dense>
 #include "Model.h"
+#include "ThreadPool.h"
 
 using Eigen::Vector3f;
 
-Model::Model(int x, int y, int z, float size) : size_x(x), size_y(y), size_z(z), voxel_size(size), voxels(x* y* z), colors(x* y* z), seen(x* y* z) {
-	for (int i = 0; i < x * y * z; i++) {
-		voxels[i] = MODEL_COLOR;
-		seen[i] = false;
+static int ceilLog2(int n) {
+	int bits = 0;
+	while ((1 << bits) < n) {
+		bits++;
+	}
+	return bits;
+}
+
+Model::Model(int x, int y, int z, float size, ModelStorage storage, cv::Vec3i offset, VoxelLayout layout) : size_x(x), size_y(y), size_z(z), voxel_size(size), storage(storage), offset(offset),
+	// sparse and mapped models keep their own order
+	layout(storage == ModelStorage::Sparse || storage == ModelStorage::Mapped ? VoxelLayout::Linear : layout),
+	bricks_x(((size_t)x + MODEL_BRICK_SIZE - 1) >> MODEL_BRICK_BITS), bricks_y(((size_t)y + MODEL_BRICK_SIZE - 1) >> MODEL_BRICK_BITS),
+	row_bits(ceilLog2(x + 2 * MODEL_GHOST_LAYER)), slice_bits(row_bits + ceilLog2(y + 2 * MODEL_GHOST_LAYER)),
+	occupied(storage == ModelStorage::Compact ? voxelCount() : 0, false),
+	implicitBricks(true), seen(storage != ModelStorage::Sparse && storage != ModelStorage::Mapped ? voxelCount() : 0, false) {
+	// the bit words are first touched like the voxel arrays, by the threads that carve their voxels
+	for (AtomicBitset* bits : { &occupied, &seen }) {
+		bool value = bits == &occupied;
+		fillParallel(bits->wordCount(), [&](size_t begin, size_t end) {
+			bits->fillWords(begin, end, value);
+		});
+	}
+	if (storage == ModelStorage::Dense) {
+		voxels.resize(voxelCount());
+		fillParallel(voxels.size(), [&](size_t begin, size_t end) {
+			std::fill(voxels.begin() + begin, voxels.begin() + end, MODEL_COLOR);
+		});
+	}
+	if (storage == ModelStorage::RGBA8) {
+		uint8_t modelColor[4];
+		packVoxel(MODEL_COLOR, modelColor);
+		packedVoxels.resize(4 * voxelCount());
+		fillParallel(voxelCount(), [&](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++) {
+				std::memcpy(&packedVoxels[4 * i], modelColor, 4);
+			}
+		});
+	}
+	if (this->layout == VoxelLayout::Padded) {
+		clearGhostLayer();
 	}
 };
 
-void Model::set(int x, int y, int z, const Vector4f& v) {
-	voxels[flatten(x, y, z)] = v;
+void Model::clearGhostLayer() {
+	int y_bits = slice_bits - row_bits;
+	size_t row_length = (size_t)size_x + 2 * MODEL_GHOST_LAYER;
+	// padded models are never sparse
+	dispatchVoxelArrays(*this, [&](auto& grid) {
+		fillParallel(voxelCount(), [&](size_t begin, size_t end) {
+			// clears the voxels [from, to) that lie within the part
+			auto clear = [&](size_t from, size_t to) {
+				for (size_t i = std::max(from, begin); i < std::min(to, end); i++) {
+					grid.setIndex(i, Vector4f(0, 0, 0, 0));
+				}
+			};
+			for (size_t row = begin >> row_bits; (row << row_bits) < end; row++) {
+				int y = (int)(row & ((size_t(1) << y_bits) - 1)) - MODEL_GHOST_LAYER;
+				int z = (int)(row >> y_bits) - MODEL_GHOST_LAYER;
+				if (y >= size_y + MODEL_GHOST_LAYER) { // padding of the slice, never read
+					continue;
+				}
+				size_t first = row << row_bits;
+				if (y < 0 || y >= size_y || z < 0 || z >= size_z) {
+					clear(first, first + row_length);
+				}
+				else {
+					// only the first and last voxels of interior rows are ghosts
+					clear(first, first + MODEL_GHOST_LAYER);
+					clear(first + MODEL_GHOST_LAYER + size_x, first + row_length);
+				}
+			}
+		});
+	});
+}
+
+void Model::fillParallel(size_t n, const std::function<void(size_t, size_t)>& fill) {
+	// the same z-slabs as the standard carving on the same threads, so a page is touched first by the thread that carves it
+	ThreadPool::GetInstance().ParallelForStatic(0, size_z, [&](int z_begin, int z_end) {
+		fill(n * z_begin / size_z, n * z_end / size_z);
+	});
+}
+
+void Model::enableCoverage() {
+	coverage.resize(voxelCount());
+	fillParallel(coverage.size(), [&](size_t begin, size_t end) {
+		std::fill(coverage.begin() + begin, coverage.begin() + end, 1.f);
+	});
+}
+
+void Model::enableCarveRecord() {
+	carveCounts.resize(voxelCount());
+	carveViews.resize(carveCounts.size());
+	fillParallel(carveCounts.size(), [&](size_t begin, size_t end) {
+		std::fill(carveCounts.begin() + begin, carveCounts.begin() + end, 0);
+		std::fill(carveViews.begin() + begin, carveViews.begin() + end, 0);
+	});
+}
+
+size_t Model::voxelCount(int x, int y, int z, VoxelLayout layout) {
+	if (layout == VoxelLayout::Bricked) {
+		size_t bricks = (((size_t)x + MODEL_BRICK_SIZE - 1) >> MODEL_BRICK_BITS) * (((size_t)y + MODEL_BRICK_SIZE - 1) >> MODEL_BRICK_BITS)
+			* (((size_t)z + MODEL_BRICK_SIZE - 1) >> MODEL_BRICK_BITS);
+		return bricks << (3 * MODEL_BRICK_BITS);
+	}
+	if (layout == VoxelLayout::Padded) {
+		return ((size_t)z + 2 * MODEL_GHOST_LAYER) << (ceilLog2(x + 2 * MODEL_GHOST_LAYER) + ceilLog2(y + 2 * MODEL_GHOST_LAYER));
+	}
+	return (size_t)x * y * z;
+}
+
+size_t Model::memorySize(int x, int y, int z, ModelStorage storage, VoxelLayout layout) {
+	bool ownOrder = storage == ModelStorage::Sparse || storage == ModelStorage::Mapped;
+	size_t n = voxelCount(x, y, z, ownOrder ? VoxelLayout::Linear : layout);
+	switch (storage) {
+	case ModelStorage::Compact:
+		// occupancy and seen bits
+		return n / 4;
+	case ModelStorage::Sparse:
+		return n / 4 + n * sizeof(Vector4f);
+	case ModelStorage::Mapped:
+		return n / 4 + n * 4;
+	case ModelStorage::RGBA8:
+		return n * 4 + n / 8;
+	default:
+		return n * sizeof(Vector4f) + n / 8;
+	}
+}
+
+void Model::setMapped(size_t i, const Vector4f& v) {
+	if (v.w() == 0) {
+		occupied.reset(i);
+		return;
+	}
+	packVoxel(v, mappedColors + 4 * i);
+	occupied.set(i);
+}
+
+void Model::setCompact(size_t i, const Vector4f& v) {
+	if (v.w() == 0) {
+		// colors of carved voxels are never read, so carving only touches the (thread safe) occupancy bit
+		occupied.reset(i);
+		return;
+	}
+	occupied.set(i);
+	if (v.head<3>() == defaultCompact(i).head<3>()) {
+		if (colored.size() > 0 && colored.test(i)) {
+			colored.reset(i);
+			sparseVoxels.erase(i);
+		}
+		return;
+	}
+	if (colored.size() == 0) {
+		// colors are set serially (like the map), runs without color reconstruction never allocate the bits
+		colored = AtomicBitset(occupied.size());
+	}
+	colored.set(i);
+	sparseVoxels[i] = Vector4f(v.x(), v.y(), v.z(), 1);
+}
+
+void Model::setSparse(int x, int y, int z, const Vector4f& v) {
+	VoxelBrick* brick = findBrick(x, y, z);
+	if (!brick) {
+		if (v.w() == 0 && !implicitBricks) {
+			return;
+		}
+		// allocating bricks is not thread safe, carving only removes voxels of allocated bricks
+		brick = &bricks.try_emplace(brickKey(x, y, z), implicitBricks).first->second;
+	}
+	std::atomic<uint64_t>& word = brick->occupied[z & (MODEL_BRICK_SIZE - 1)];
+	uint64_t bit = brickBit(x, y);
+	if (v.w() == 0) {
+		if (word.load(std::memory_order_relaxed) & bit) {
+			word.fetch_and(~bit, std::memory_order_relaxed);
+		}
+		return;
+	}
+	if (!(word.load(std::memory_order_relaxed) & bit)) {
+		word.fetch_or(bit, std::memory_order_relaxed);
+	}
+	Vector4f color(v.x(), v.y(), v.z(), 1);
+	if (brick->colors.empty()) {
+		if (color == MODEL_COLOR) {
+			return;
+		}
+		brick->colors.assign(MODEL_BRICK_SIZE * MODEL_BRICK_SIZE * MODEL_BRICK_SIZE, MODEL_COLOR);
+	}
+	brick->colors[brickIndex(x, y, z)] = color;
+}
+
+std::vector<cv::Vec3i> Model::getBricks(int margin) {
+	int bricks_x = (getX() + MODEL_BRICK_SIZE - 1) >> MODEL_BRICK_BITS;
+	int bricks_y = (getY() + MODEL_BRICK_SIZE - 1) >> MODEL_BRICK_BITS;
+	int bricks_z = (getZ() + MODEL_BRICK_SIZE - 1) >> MODEL_BRICK_BITS;
+	std::vector<cv::Vec3i> origins;
+	if (storage != ModelStorage::Sparse || implicitBricks) {
+		for (int z = 0; z < bricks_z; z++) {
+			for (int y = 0; y < bricks_y; y++) {
+				for (int x = 0; x < bricks_x; x++) {
+					origins.push_back(cv::Vec3i(x, y, z) * MODEL_BRICK_SIZE);
+				}
+			}
+		}
+		return origins;
+	}
+
+	// keys order the bricks by z, y and x
+	std::vector<uint64_t> keys;
+	for (auto& brick : bricks) {
+		int x = (int)(brick.first & 0x1FFFFF), y = (int)(brick.first >> 21 & 0x1FFFFF), z = (int)(brick.first >> 42);
+		for (int k = std::max(0, z - margin); k <= std::min(bricks_z - 1, z + margin); k++) {
+			for (int j = std::max(0, y - margin); j <= std::min(bricks_y - 1, y + margin); j++) {
+				for (int i = std::max(0, x - margin); i <= std::min(bricks_x - 1, x + margin); i++) {
+					keys.push_back(brickKey(i << MODEL_BRICK_BITS, j << MODEL_BRICK_BITS, k << MODEL_BRICK_BITS));
+				}
+			}
+		}
+	}
+	std::sort(keys.begin(), keys.end());
+	keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+	for (uint64_t key : keys) {
+		origins.push_back(cv::Vec3i((int)(key & 0x1FFFFF), (int)(key >> 21 & 0x1FFFFF), (int)(key >> 42)) * MODEL_BRICK_SIZE);
+	}
+	return origins;
+}
+
+void Model::allocateBricks(const std::vector<cv::Vec3i>& origins) {
+	for (const cv::Vec3i& origin : origins) {
+		bricks.try_emplace(brickKey(origin(0), origin(1), origin(2)), true);
+	}
+	implicitBricks = false;
+}
+
+int Model::releaseEmptyBricks() {
+	for (auto it = bricks.begin(); it != bricks.end();) {
+		bool empty = true;
+		for (int i = 0; i < MODEL_BRICK_SIZE && empty; i++) {
+			empty = it->second.occupied[i].load(std::memory_order_relaxed) == 0;
+		}
+		it = empty ? bricks.erase(it) : std::next(it);
+	}
+	return (int)bricks.size();
 }
 
 std::string Model::to_string() {
@@ -33,13 +268,56 @@ std::string Model::to_string() {
 	return ss.str();
 }
 
+static int countBits(uint64_t bits) {
+	int count = 0;
+	for (; bits; bits &= bits - 1) {
+		count++;
+	}
+	return count;
+}
+
+int Model::applyCarveRecord(int minViews, uint64_t removedViews) {
+	std::cout << "LOG - VC: applying carve record (" << countBits(removedViews) << " views removed, " << minViews << " views to carve a voxel)." << std::endl;
+	int changed = 0;
+	for (int z = 0; z < getZ(); z++) {
+		for (int y = 0; y < getY(); y++) {
+			for (int x = 0; x < getX(); x++) {
+				size_t i = flatten(x, y, z);
+				uint64_t removed = carveViews[i] & removedViews;
+				if (removed) {
+					carveViews[i] &= ~removed;
+					// saturated counts are not exact anymore and stay as they are
+					if (carveCounts[i] < UINT16_MAX) {
+						carveCounts[i] -= countBits(removed);
+					}
+				}
+				bool carved = carveCounts[i] >= minViews;
+				if (carved == isOccupied(x, y, z)) {
+					set(x, y, z, carved ? Vector4f(0, 0, 0, 0) : MODEL_COLOR);
+					changed++;
+				}
+			}
+		}
+	}
+	std::cout << "LOG - VC: carve record applied, " << changed << " voxels changed." << std::endl;
+	return changed;
+}
+
 void Model::handleUnseen() {
 	std::cout << "LOG - PP: marking unseen voxels from model." << std::endl;
-	for (int x = 0; x < getX(); x++) {
-		for (int y = 0; y < getY(); y++) {
-			for (int z = 0; z < getZ(); z++) {
-				if (!seen[flatten(x, y, z)]) {
-					set(x, y, z, UNSEEN_COLOR);
+	if (storage == ModelStorage::Compact) {
+		// the unseen color follows from the seen bits
+		unseenMarked = true;
+		return;
+	}
+	for (const cv::Vec3i& origin : getBricks()) {
+		cv::Vec3i end = brickEnd(origin);
+		for (int z = origin(2); z < end(2); z++) {
+			for (int y = origin(1); y < end(1); y++) {
+				for (int x = origin(0); x < end(0); x++) {
+					if (!isSeen(x, y, z)) {
+						set(x, y, z, UNSEEN_COLOR);
+					}
 				}
 			}
 		}
@@ -60,29 +338,33 @@ bool Model::WriteModel(const std::string& filename) {
 	// calculate vertices and faces
 	std::vector<Vector3f> vertices;
 	std::vector<Square> faces;
+	Vector3f origin((float)offset(0), (float)offset(1), (float)offset(2));
 
-	for (int x = 0; x < getX(); x++) {
-		for (int y = 0; y < getY(); y++) {
-			for (int z = 0; z < getZ(); z++) {
-				if (get(x, y, z)(3) == 0 || isInner(x, y, z)) {
-					continue;
+	for (const cv::Vec3i& brick : getBricks()) {
+		cv::Vec3i end = brickEnd(brick);
+		for (int z = brick(2); z < end(2); z++) {
+			for (int y = brick(1); y < end(1); y++) {
+				for (int x = brick(0); x < end(0); x++) {
+					if (!isOccupied(x, y, z) || isInner(x, y, z)) {
+						continue;
+					}
+					int vId = vertices.size();
+					vertices.push_back(Vector3f(x, y, z) + origin);				//id	0
+					vertices.push_back(Vector3f(x + 1, y, z) + origin);			//id+1	r
+					vertices.push_back(Vector3f(x, y + 1, z) + origin);			//id+2	u
+					vertices.push_back(Vector3f(x, y, z + 1) + origin);			//id+3	h
+					vertices.push_back(Vector3f(x + 1, y + 1, z) + origin);		//id+4	ru
+					vertices.push_back(Vector3f(x + 1, y, z + 1) + origin);		//id+5	rh
+					vertices.push_back(Vector3f(x, y + 1, z + 1) + origin);		//id+6	uh
+					vertices.push_back(Vector3f(x + 1, y + 1, z + 1) + origin);	//id+7	ruh
+
+					faces.push_back(Square(vId, vId + 2, vId + 4, vId + 1, get(x, y, z).x(), get(x, y, z).y(), get(x, y, z).z())); // front
+					faces.push_back(Square(vId + 3, vId + 5, vId + 7, vId + 6, get(x, y, z).x(), get(x, y, z).y(), get(x, y, z).z())); // back
+					faces.push_back(Square(vId, vId + 2, vId + 6, vId + 3, get(x, y, z).x(), get(x, y, z).y(), get(x, y, z).z())); // left
+					faces.push_back(Square(vId + 1, vId + 4, vId + 7, vId + 5, get(x, y, z).x(), get(x, y, z).y(), get(x, y, z).z())); // right
+					faces.push_back(Square(vId + 2, vId + 6, vId + 7, vId + 4, get(x, y, z).x(), get(x, y, z).y(), get(x, y, z).z())); // top
+					faces.push_back(Square(vId, vId + 3, vId + 5, vId + 1, get(x, y, z).x(), get(x, y, z).y(), get(x, y, z).z())); // bottom
 				}
-				int vId = vertices.size();
-				vertices.push_back(Vector3f(x, y, z));				//id	0
-				vertices.push_back(Vector3f(x + 1, y, z));			//id+1	r
-				vertices.push_back(Vector3f(x, y + 1, z));			//id+2	u
-				vertices.push_back(Vector3f(x, y, z + 1));			//id+3	h
-				vertices.push_back(Vector3f(x + 1, y + 1, z));		//id+4	ru
-				vertices.push_back(Vector3f(x + 1, y, z + 1));		//id+5	rh
-				vertices.push_back(Vector3f(x, y + 1, z + 1));		//id+6	uh
-				vertices.push_back(Vector3f(x + 1, y + 1, z + 1));	//id+7	ruh
-
-				faces.push_back(Square(vId, vId + 2, vId + 4, vId + 1, get(x, y, z).x(), get(x, y, z).y(), get(x, y, z).z())); // front
-				faces.push_back(Square(vId + 3, vId + 5, vId + 7, vId + 6, get(x, y, z).x(), get(x, y, z).y(), get(x, y, z).z())); // back
-				faces.push_back(Square(vId, vId + 2, vId + 6, vId + 3, get(x, y, z).x(), get(x, y, z).y(), get(x, y, z).z())); // left
-				faces.push_back(Square(vId + 1, vId + 4, vId + 7, vId + 5, get(x, y, z).x(), get(x, y, z).y(), get(x, y, z).z())); // right
-				faces.push_back(Square(vId + 2, vId + 6, vId + 7, vId + 4, get(x, y, z).x(), get(x, y, z).y(), get(x, y, z).z())); // top
-				faces.push_back(Square(vId, vId + 3, vId + 5, vId + 1, get(x, y, z).x(), get(x, y, z).y(), get(x, y, z).z())); // bottom
 			}
 		}
 	}
@@ -105,3 +387,260 @@ bool Model::WriteModel(const std::string& filename) {
 
 	return true;
 }
+
+// snapshot format
+#define SNAPSHOT_MAGIC "AVXSNAP"
+#define SNAPSHOT_VERSION 1
+// sections start at page boundaries, so they can be used in place when the file is mapped
+#define SNAPSHOT_ALIGNMENT 4096
+
+struct SnapshotHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t headerSize;
+	int32_t dims[3];
+	int32_t offset[3];
+	float voxelSize;
+	uint32_t reserved;
+	uint64_t occupancyOffset;	// byte offsets of the sections
+	uint64_t seenOffset;
+	uint64_t colorsOffset;
+	uint64_t fileSize;
+	uint64_t viewsOffset;		// names and poses of the applied views
+	uint64_t viewCount;
+	double cameraMatrix[9];		// calibration the poses of the applied views were estimated with
+	double distCoeffs[14];
+	uint32_t distCount;			// number of distortion coefficients, 0 if the calibration is unknown
+	uint32_t reserved3;
+};
+
+// follows the name of every applied view
+struct SnapshotPose {
+	uint32_t hasPose;
+	int32_t size[2];
+	float pose[12];
+};
+
+// distortion models of OpenCV have at most 14 coefficients
+#define SNAPSHOT_MAX_DIST_COEFFS 14
+
+void Model::setCalibration(const cv::Mat& cameraMatrix, const cv::Mat& distCoeffs) {
+	cameraMatrix.convertTo(this->cameraMatrix, CV_64F);
+	distCoeffs.convertTo(this->distCoeffs, CV_64F);
+	this->distCoeffs = this->distCoeffs.reshape(1, 1);
+}
+
+bool Model::hasCalibration(const cv::Mat& cameraMatrix, const cv::Mat& distCoeffs) {
+	if (this->cameraMatrix.empty() || cameraMatrix.total() != this->cameraMatrix.total() || distCoeffs.total() != this->distCoeffs.total()) {
+		return false;
+	}
+	cv::Mat K, D;
+	cameraMatrix.convertTo(K, CV_64F);
+	distCoeffs.convertTo(D, CV_64F);
+	for (int i = 0; i < (int)K.total(); i++) {
+		if (K.at<double>(i) != this->cameraMatrix.at<double>(i)) {
+			return false;
+		}
+	}
+	for (int i = 0; i < (int)D.total(); i++) {
+		if (D.at<double>(i) != this->distCoeffs.at<double>(i)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static uint64_t alignSection(uint64_t offset) {
+	return (offset + SNAPSHOT_ALIGNMENT - 1) / SNAPSHOT_ALIGNMENT * SNAPSHOT_ALIGNMENT;
+}
+
+bool Model::WriteSnapshot(const std::string& filename) {
+	std::cout << "LOG - Snapshot: writing snapshot " << filename << "..." << std::endl;
+	size_t n = (size_t)getX() * getY() * getZ();
+	size_t words = (n + 63) / 64;
+
+	SnapshotHeader header = {};
+	std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+	header.version = SNAPSHOT_VERSION;
+	header.headerSize = sizeof(SnapshotHeader);
+	for (int i = 0; i < 3; i++) {
+		header.offset[i] = offset(i);
+	}
+	header.dims[0] = getX();
+	header.dims[1] = getY();
+	header.dims[2] = getZ();
+	header.voxelSize = voxel_size;
+	header.occupancyOffset = alignSection(sizeof(SnapshotHeader));
+	header.seenOffset = alignSection(header.occupancyOffset + words * sizeof(uint64_t));
+	header.colorsOffset = alignSection(header.seenOffset + words * sizeof(uint64_t));
+	header.viewsOffset = header.colorsOffset + 4 * n;
+	header.viewCount = appliedViews.size();
+	header.fileSize = header.viewsOffset;
+	for (const AppliedView& view : appliedViews) {
+		header.fileSize += sizeof(uint32_t) + view.name.size() + sizeof(SnapshotPose);
+	}
+	if (cameraMatrix.total() == 9 && distCoeffs.total() <= SNAPSHOT_MAX_DIST_COEFFS) {
+		for (int i = 0; i < 9; i++) {
+			header.cameraMatrix[i] = cameraMatrix.at<double>(i);
+		}
+		for (int i = 0; i < (int)distCoeffs.total(); i++) {
+			header.distCoeffs[i] = distCoeffs.at<double>(i);
+		}
+		header.distCount = (uint32_t)distCoeffs.total();
+	}
+
+	// the model can be mapped from the target (resumed), truncating it would pull the pages from under the mapping,
+	// so the snapshot is written next to it and replaces it once it is complete
+	std::string tmpFilename = filename + ".tmp";
+	std::ofstream outFile(tmpFilename, std::ios::binary);
+	if (!outFile.is_open()) {
+		std::cerr << "LOG(ERR) - Snapshot: could not open file " << tmpFilename << ". Aborting snapshot!" << std::endl;
+		return false;
+	}
+	outFile.write((const char*)&header, sizeof(header));
+	auto padTo = [&](uint64_t position) {
+		std::vector<char> zeros((size_t)(position - (uint64_t)outFile.tellp()));
+		outFile.write(zeros.data(), zeros.size());
+	};
+
+	// the sections are written slice by slice, so the model is never copied as a whole
+	std::vector<uint64_t> bits(((size_t)getX() * getY() + 63) / 64 + 1);
+	for (int section = 0; section < 2; section++) {
+		padTo(section == 0 ? header.occupancyOffset : header.seenOffset);
+		uint64_t word = 0;
+		size_t i = 0;
+		for (int z = 0; z < getZ(); z++) {
+			size_t count = 0;
+			for (int y = 0; y < getY(); y++) {
+				for (int x = 0; x < getX(); x++, i++) {
+					if (section == 0 ? isOccupied(x, y, z) : isSeen(x, y, z)) {
+						word |= uint64_t(1) << (i & 63);
+					}
+					if ((i & 63) == 63) {
+						bits[count++] = word;
+						word = 0;
+					}
+				}
+			}
+			outFile.write((const char*)bits.data(), count * sizeof(uint64_t));
+		}
+		if (n & 63) {
+			outFile.write((const char*)&word, sizeof(uint64_t));
+		}
+	}
+
+	padTo(header.colorsOffset);
+	std::vector<uint8_t> colors(4 * (size_t)getX() * getY());
+	for (int z = 0; z < getZ(); z++) {
+		for (int y = 0; y < getY(); y++) {
+			for (int x = 0; x < getX(); x++) {
+				packVoxel(get(x, y, z), &colors[4 * (x + (size_t)getX() * y)]);
+			}
+		}
+		outFile.write((const char*)colors.data(), colors.size());
+	}
+
+	for (const AppliedView& view : appliedViews) {
+		uint32_t length = (uint32_t)view.name.size();
+		outFile.write((const char*)&length, sizeof(length));
+		outFile.write(view.name.data(), length);
+		SnapshotPose pose = {};
+		// poses estimated with another calibration than the stored one are not kept
+		pose.hasPose = view.hasPose && header.distCount > 0;
+		pose.size[0] = view.size.width;
+		pose.size[1] = view.size.height;
+		for (int i = 0; i < 12; i++) {
+			pose.pose[i] = view.pose.val[i];
+		}
+		outFile.write((const char*)&pose, sizeof(pose));
+	}
+
+	outFile.close();
+	std::error_code error;
+	if (!outFile.good()) {
+		std::cerr << "LOG(ERR) - Snapshot: could not write file " << tmpFilename << "." << std::endl;
+		std::filesystem::remove(tmpFilename, error);
+		return false;
+	}
+	// a mapping of the old file keeps its data until it is unmapped (Windows refuses to replace a mapped file)
+	std::filesystem::rename(tmpFilename, filename, error);
+	if (error) {
+		std::cerr << "LOG(ERR) - Snapshot: could not replace " << filename << " (" << error.message() << "), the snapshot is kept in " << tmpFilename << "." << std::endl;
+		return false;
+	}
+	std::cout << "LOG - Snapshot: snapshot written." << std::endl;
+	return true;
+}
+
+std::unique_ptr<Model> Model::ReadSnapshot(const std::string& filename) {
+	std::unique_ptr<MappedFile> file(new MappedFile(filename));
+	if (!file->isOpen()) {
+		return nullptr;
+	}
+	SnapshotHeader header;
+	if (file->size() < sizeof(header)) {
+		std::cerr << "LOG(ERR) - Snapshot: " << filename << " is no snapshot." << std::endl;
+		return nullptr;
+	}
+	std::memcpy(&header, file->data(), sizeof(header));
+	if (std::memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+		std::cerr << "LOG(ERR) - Snapshot: " << filename << " is no snapshot." << std::endl;
+		return nullptr;
+	}
+	if (header.version != SNAPSHOT_VERSION || header.headerSize != sizeof(header)) {
+		std::cerr << "LOG(ERR) - Snapshot: version " << header.version << " of " << filename << " is not supported (expected " << SNAPSHOT_VERSION << ")." << std::endl;
+		return nullptr;
+	}
+	size_t n = (size_t)header.dims[0] * header.dims[1] * header.dims[2];
+	size_t words = (n + 63) / 64;
+	if (header.dims[0] < 1 || header.dims[1] < 1 || header.dims[2] < 1 || header.fileSize > file->size()
+		|| header.occupancyOffset % SNAPSHOT_ALIGNMENT != 0 || header.seenOffset % SNAPSHOT_ALIGNMENT != 0
+		|| header.occupancyOffset + words * sizeof(uint64_t) > header.seenOffset || header.seenOffset + words * sizeof(uint64_t) > header.colorsOffset
+		|| header.colorsOffset + 4 * n > header.viewsOffset || header.viewsOffset > header.fileSize) {
+		std::cerr << "LOG(ERR) - Snapshot: " << filename << " is truncated or corrupt." << std::endl;
+		return nullptr;
+	}
+
+	std::unique_ptr<Model> model(new Model(header.dims[0], header.dims[1], header.dims[2], header.voxelSize, ModelStorage::Mapped,
+		cv::Vec3i(header.offset[0], header.offset[1], header.offset[2])));
+	model->occupied = AtomicBitset((uint64_t*)(file->data() + header.occupancyOffset), n);
+	model->seen = AtomicBitset((uint64_t*)(file->data() + header.seenOffset), n);
+	model->mappedColors = file->data() + header.colorsOffset;
+	if (header.distCount > 0 && header.distCount <= SNAPSHOT_MAX_DIST_COEFFS) {
+		model->setCalibration(cv::Mat(3, 3, CV_64F, header.cameraMatrix), cv::Mat(1, (int)header.distCount, CV_64F, header.distCoeffs));
+	}
+	// the view names are copied, they are small and the list grows when further views are carved
+	uint64_t position = header.viewsOffset;
+	for (uint64_t v = 0; v < header.viewCount; v++) {
+		uint32_t length;
+		if (position + sizeof(length) > header.fileSize) {
+			std::cerr << "LOG(ERR) - Snapshot: " << filename << " is truncated or corrupt." << std::endl;
+			return nullptr;
+		}
+		std::memcpy(&length, file->data() + position, sizeof(length));
+		position += sizeof(length);
+		if (position + length > header.fileSize) {
+			std::cerr << "LOG(ERR) - Snapshot: " << filename << " is truncated or corrupt." << std::endl;
+			return nullptr;
+		}
+		model->appliedViews.push_back(AppliedView(std::string((const char*)file->data() + position, length)));
+		position += length;
+		SnapshotPose pose;
+		if (position + sizeof(pose) > header.fileSize) {
+			std::cerr << "LOG(ERR) - Snapshot: " << filename << " is truncated or corrupt." << std::endl;
+			return nullptr;
+		}
+		std::memcpy(&pose, file->data() + position, sizeof(pose));
+		position += sizeof(pose);
+		AppliedView& view = model->appliedViews.back();
+		view.hasPose = pose.hasPose != 0 && !model->cameraMatrix.empty();
+		view.size = cv::Size(pose.size[0], pose.size[1]);
+		for (int i = 0; i < 12; i++) {
+			view.pose.val[i] = pose.pose[i];
+		}
+	}
+	model->snapshot = std::move(file);
+	std::cout << "LOG - Snapshot: mapped " << model->getX() << "x" << model->getY() << "x" << model->getZ() << " voxels (" << model->appliedViews.size()
+		<< " applied views) from " << filename << "." << std::endl;
+	return model;
+}
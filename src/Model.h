@@ -2,76 +2,23 @@
 #define MODEL_H
 
 #include "Utils.h"
+#include "AtomicBitset.h"
+#include "MappedFile.h"
+#include "HugePageAllocator.h"
+#include<algorithm>
+#include<atomic>
+#include<cmath>
+#include<cstring>
+#include<functional>
+#include<memory>
+#include<string>
+#include<unordered_map>
+#include<vector>
 #include<Eigen/Dense>
 #include <opencv2/core/mat.hpp>
 
-#if (GCC_COMPILER_DETECTED || CLANG_COMPILER_DETECTED)
-
-#define for_each_voxel(x, y, z) \
-    if (1) \
-    { \
-        x = 0; \
-        for (; x < model.getX(); x++) \
-        { \
-            y = 0; \
-            for (; y < model.getY(); y++) \
-            { \
-                z = 0; \
-                for (; z < model.getZ(); z++) \
-                { \
-                    goto body; \
-                    loop_continue: ; \
-                } \
-            } \
-        } \
-    } \
-    else \
-        while(1) \
-            if(1) \
-            { \
-                goto loop_continue; \
-            } \
-            else \
-                body:
-
-#else
-
-#define for_each_voxel(x, y, z) \
-    if (1) \
-    { \
-        x = 0; \
-        for (; x < model.getX(); x++) \
-        { \
-            y = 0; \
-            for (; y < model.getY(); y++) \
-            { \
-                z = 0; \
-                for (; z < model.getZ(); z++) \
-                { \
-                    goto label(body, __LINE__); \
-                    label(loop_continue, __LINE__): ; \
-                } \
-            } \
-        } \
-    } \
-    else \
-        while(1) \
-            if(1) \
-            { \
-                goto label(loop_continue, __LINE__); \
-            } \
-            else \
-                label(body, __LINE__):
-
-#endif
-
 using Eigen::Vector4f;
 
-struct DCLR {
-	Vector4f color;
-	float depth;
-};
-
 struct Square {
 	// vertex ids
 	unsigned int idx0;
@@ -90,6 +37,102 @@ struct Square {
 #define MODEL_COLOR Vector4f(50, 168, 141, 1) // Vector4f(255, 255, 255, 1)
 #define UNSEEN_COLOR Vector4f(204, 0, 0, 1)
 
+/**
+ * Memory layout of the voxels of a model.
+ * Dense:	one Vector4f per voxel.
+ * RGBA8:	one packed RGBA8 color per voxel (alpha scaled to 0..255), a quarter of the dense voxels. Colors are rounded to integers.
+ * Compact:	one occupancy bit per voxel (1/128 of the dense voxels), for runs without color reconstruction. Occupied voxels have the model color,
+ *			or the unseen color if no view sees them once unseen voxels have been marked (handleUnseen). Other colors are only stored for the voxels
+ *			that have one, alpha values are reduced to 0 or 1.
+ * Sparse:	hash map of bricks of 8^3 voxels, which are only allocated where carving leaves something (memory scales with the occupied volume).
+ *			Voxels of missing bricks are carved. Colors are stored per brick once a voxel of it gets a color, alpha values are reduced to 0 or 1.
+ *			Until the first carving all voxels are occupied without any brick being allocated.
+ * Mapped:	snapshot file (Model::ReadSnapshot) mapped copy-on-write, occupancy and seen bits and one RGBA8 color per voxel are used in place.
+ *			Pages are only read when they are accessed and changes are never written back. Models of this layout are only created from snapshots.
+ */
+enum class ModelStorage {
+	Dense,
+	Compact,
+	Sparse,
+	Mapped,
+	RGBA8
+};
+
+/**
+ * Order of the voxels of the per-voxel arrays of a model (all but sparse and mapped storage, which have their own order).
+ * Linear:	x + X * (y + Y * z), x fastest. Neighbours in z are X * Y voxels apart.
+ * Bricked:	bricks of 8^3 voxels (x fastest within a brick) in x, y, z order of the bricks, so the neighbourhood of a voxel
+ *			lies within a few cache lines and pages. Grids are padded to whole bricks. The stages iterate brick by brick (Model::getBricks).
+ * Padded:	linear with a ghost layer of MODEL_GHOST_LAYER carved voxels around the grid and rows and slices padded to powers of two,
+ *			so neighbours of voxels are read without bounds checks (Model::getNear) and indices are computed with shifts.
+ */
+enum class VoxelLayout {
+	Linear,
+	Bricked,
+	Padded
+};
+
+// allocator of the large per-voxel arrays of models, huge pages and no initialisation on resize (filled in parallel by the model)
+template <class T>
+using VoxelArray = HugePageVector<T>;
+
+// voxels around the grid of padded models, enough for the surface test, marching cubes and a closure with a kernel size of 3
+#define MODEL_GHOST_LAYER 1
+
+/**
+ * @brief Packs a voxel into 4 bytes (RGBA8, alpha scaled to 0..255), the format of snapshots and backing files.
+ */
+inline void packVoxel(const Vector4f& v, uint8_t* rgba) {
+	for (int c = 0; c < 3; c++) {
+		rgba[c] = (uint8_t)std::lround(std::min(std::max(v(c), 0.f), 255.f));
+	}
+	rgba[3] = (uint8_t)std::lround(std::min(std::max(v.w(), 0.f), 1.f) * 255);
+}
+
+inline Vector4f unpackVoxel(const uint8_t* rgba) {
+	return Vector4f(rgba[0], rgba[1], rgba[2], rgba[3] / 255.f);
+}
+
+// edge length of the bricks of sparse models (and of the blocks models are iterated in), 2^MODEL_BRICK_BITS
+#define MODEL_BRICK_BITS 3
+#define MODEL_BRICK_SIZE (1 << MODEL_BRICK_BITS)
+
+/**
+ * @brief Brick of a sparse model: occupancy and seen bits can be written from several threads (one word per z-layer of the brick).
+ */
+struct VoxelBrick {
+	std::atomic<uint64_t> occupied[MODEL_BRICK_SIZE];
+	std::atomic<uint64_t> seen[MODEL_BRICK_SIZE];
+	std::vector<Vector4f> colors; // empty while all voxels have the model color
+
+	VoxelBrick(bool full) {
+		for (int i = 0; i < MODEL_BRICK_SIZE; i++) {
+			occupied[i].store(full ? ~uint64_t(0) : 0, std::memory_order_relaxed);
+			seen[i].store(0, std::memory_order_relaxed);
+		}
+	}
+};
+
+/**
+ * @brief View (image) carved into a model. Snapshots keep its pose, so incremental runs neither estimate it again nor load its frames unless they need its colors.
+ */
+struct AppliedView {
+	std::string name;	// image file name
+	bool hasPose;		// false if the pose is unknown (e.g. estimated with another calibration), it is estimated again when it is needed
+	cv::Matx34f pose;	// 3x4 world to camera transformation the view was carved with
+	cv::Size size;		// image size
+
+	AppliedView(const std::string& name) : name(name), hasPose(false) {}
+	AppliedView(const std::string& name, const cv::Mat& pose, cv::Size size) : name(name), hasPose(true), pose(pose), size(size) {}
+
+	bool operator==(const AppliedView& other) const {
+		return name == other.name && hasPose == other.hasPose && (!hasPose || (pose == other.pose && size == other.size));
+	}
+};
+
+template <ModelStorage Storage, VoxelLayout Layout>
+class VoxelAccess;
+
 class Model
 {
 private:
@@ -97,16 +140,210 @@ private:
 	const int size_y;
 	const int size_z;
 	const float voxel_size;
-	std::vector<Vector4f> voxels;
-	std::vector<std::vector<DCLR>> colors;
-	std::vector<bool> seen;
+	const ModelStorage storage;
+	const cv::Vec3i offset; // position of voxel (0, 0, 0) in the lattice of voxels anchored at the world origin
+	const VoxelLayout layout;
+	const size_t bricks_x; // number of bricks in x and y direction (bricked layout)
+	const size_t bricks_y;
+	const int row_bits; // log2 of the padded row and slice lengths (padded layout)
+	const int slice_bits;
+
+	// dense storage
+	VoxelArray<Vector4f> voxels;
 
-	int flatten(int x, int y, int z) {
-		return x + getX() * (y + getY() * z);
+	// RGBA8 storage
+	VoxelArray<uint8_t> packedVoxels;
+
+	// compact storage, colors that differ from the default color are kept in sparseVoxels (colored is allocated with the first of them)
+	AtomicBitset occupied;
+	AtomicBitset colored;
+	std::unordered_map<size_t, Vector4f> sparseVoxels;
+	bool unseenMarked = false; // whether handleUnseen has been applied, the default color of voxels no view sees is the unseen color then
+
+	// sparse storage
+	std::unordered_map<uint64_t, VoxelBrick> bricks;
+	bool implicitBricks; // whether the bricks have not been allocated yet, all voxels are occupied until then
+
+	// mapped storage, occupied and seen are views of the mapping
+	std::unique_ptr<MappedFile> snapshot;
+	uint8_t* mappedColors = nullptr; // RGBA8
+
+	AtomicBitset seen; // can be marked from parallel carving (all but sparse storage)
+
+	// views carved into the model, kept by snapshots so further views can be carved incrementally
+	std::vector<AppliedView> appliedViews;
+	// calibration the poses of the applied views were estimated with (CV_64F), empty if unknown
+	cv::Mat cameraMatrix;
+	cv::Mat distCoeffs;
+
+	// optional fractional inside-ness of the voxels, empty unless enabled
+	VoxelArray<float> coverage;
+
+	// optional record of the views that carved the voxels (count of all views, bitmask of the first 64), empty unless enabled
+	VoxelArray<uint16_t> carveCounts;
+	VoxelArray<uint64_t> carveViews;
+
+	// index of the voxel in the per-voxel arrays for the given layout, which has to be the layout of the model
+	template <VoxelLayout Layout>
+	size_t flattenAs(int x, int y, int z) {
+		if constexpr (Layout == VoxelLayout::Bricked) {
+			size_t brick = (x >> MODEL_BRICK_BITS) + bricks_x * ((y >> MODEL_BRICK_BITS) + bricks_y * (z >> MODEL_BRICK_BITS));
+			return brick << (3 * MODEL_BRICK_BITS) | brickIndex(x, y, z);
+		}
+		else if constexpr (Layout == VoxelLayout::Padded) {
+			return ((size_t)(z + MODEL_GHOST_LAYER) << slice_bits) + ((size_t)(y + MODEL_GHOST_LAYER) << row_bits) + (x + MODEL_GHOST_LAYER);
+		}
+		else {
+			return x + (size_t)getX() * (y + (size_t)getY() * z);
+		}
+	}
+
+	size_t flatten(int x, int y, int z) {
+		if (layout == VoxelLayout::Bricked) {
+			return flattenAs<VoxelLayout::Bricked>(x, y, z);
+		}
+		if (layout == VoxelLayout::Padded) {
+			return flattenAs<VoxelLayout::Padded>(x, y, z);
+		}
+		return flattenAs<VoxelLayout::Linear>(x, y, z);
 	};
 
+	/**
+	 * @brief Number of elements of the per-voxel arrays, including the padding of the bricked and padded layouts.
+	 */
+	size_t voxelCount() { return voxelCount(size_x, size_y, size_z, layout); }
+
+	Vector4f defaultCompact(size_t i) {
+		return unseenMarked && !seen.test(i) ? UNSEEN_COLOR : MODEL_COLOR;
+	}
+
+	Vector4f getCompact(size_t i) {
+		if (!occupied.test(i)) {
+			return Vector4f(0, 0, 0, 0);
+		}
+		if (colored.size() > 0 && colored.test(i)) {
+			return sparseVoxels.find(i)->second;
+		}
+		return defaultCompact(i);
+	}
+
+	void setCompact(size_t i, const Vector4f& v);
+
+	void setPacked(size_t i, const Vector4f& v) {
+		uint8_t* rgba = &packedVoxels[4 * i];
+		if (v.w() == 0) {
+			// carving only clears the voxel, its color is never read
+			std::memset(rgba, 0, 4);
+			return;
+		}
+		packVoxel(v, rgba);
+		// occupied voxels keep a non-zero alpha, however small their coverage
+		if (rgba[3] == 0) {
+			rgba[3] = 1;
+		}
+	}
+
+	Vector4f getMapped(size_t i) {
+		if (!occupied.test(i)) {
+			return Vector4f(0, 0, 0, 0);
+		}
+		return unpackVoxel(mappedColors + 4 * i);
+	}
+
+	void setMapped(size_t i, const Vector4f& v);
+
+	static uint64_t brickKey(int x, int y, int z) {
+		return (uint64_t)(x >> MODEL_BRICK_BITS) | (uint64_t)(y >> MODEL_BRICK_BITS) << 21 | (uint64_t)(z >> MODEL_BRICK_BITS) << 42;
+	}
+
+	// bit of the voxel within the word of its z-layer
+	static uint64_t brickBit(int x, int y) {
+		return uint64_t(1) << ((x & (MODEL_BRICK_SIZE - 1)) | (y & (MODEL_BRICK_SIZE - 1)) << MODEL_BRICK_BITS);
+	}
+
+	static int brickIndex(int x, int y, int z) {
+		return (x & (MODEL_BRICK_SIZE - 1)) | ((y & (MODEL_BRICK_SIZE - 1)) | (z & (MODEL_BRICK_SIZE - 1)) << MODEL_BRICK_BITS) << MODEL_BRICK_BITS;
+	}
+
+	VoxelBrick* findBrick(int x, int y, int z) {
+		auto it = bricks.find(brickKey(x, y, z));
+		return it == bricks.end() ? nullptr : &it->second;
+	}
+
+	bool isOccupiedSparse(int x, int y, int z) {
+		VoxelBrick* brick = findBrick(x, y, z);
+		if (!brick) {
+			return implicitBricks;
+		}
+		return brick->occupied[z & (MODEL_BRICK_SIZE - 1)].load(std::memory_order_relaxed) & brickBit(x, y);
+	}
+
+	Vector4f getSparse(int x, int y, int z) {
+		VoxelBrick* brick = findBrick(x, y, z);
+		if (!brick) {
+			return implicitBricks ? MODEL_COLOR : Vector4f(0, 0, 0, 0);
+		}
+		if (!(brick->occupied[z & (MODEL_BRICK_SIZE - 1)].load(std::memory_order_relaxed) & brickBit(x, y))) {
+			return Vector4f(0, 0, 0, 0);
+		}
+		return brick->colors.empty() ? MODEL_COLOR : brick->colors[brickIndex(x, y, z)];
+	}
+
+	void setSparse(int x, int y, int z, const Vector4f& v);
+
+	void seeSparse(int x, int y, int z) {
+		VoxelBrick* brick = findBrick(x, y, z);
+		if (brick) {
+			brick->seen[z & (MODEL_BRICK_SIZE - 1)].fetch_or(brickBit(x, y), std::memory_order_relaxed);
+		}
+	}
+
+	bool isSeenSparse(int x, int y, int z) {
+		VoxelBrick* brick = findBrick(x, y, z);
+		if (!brick) {
+			return !implicitBricks;
+		}
+		return brick->seen[z & (MODEL_BRICK_SIZE - 1)].load(std::memory_order_relaxed) & brickBit(x, y);
+	}
+
+	void clearGhostLayer();
+
+	/**
+	 * @brief Calls fill(begin, end) for the parts of the per-voxel range [0, n) on the thread pool, one part per z-slab of the standard carving
+	 * on the thread that carves it (ThreadPool::ParallelForStatic), so the pages of a new array are first touched by that thread rather than all by the calling thread.
+	 */
+	void fillParallel(size_t n, const std::function<void(size_t, size_t)>& fill);
+
+	template <ModelStorage Storage, VoxelLayout Layout>
+	friend class VoxelAccess;
+
 public:
-	Model(int x, int y, int z, float size);
+	/**
+	 * @brief Creates a grid of x * y * z voxels with all voxels occupied.
+	 *
+	 * @param x			number of voxels in x direction
+	 * @param y			number of voxels in y direction
+	 * @param z			number of voxels in z direction
+	 * @param size		side length of a voxel
+	 * @param storage	memory layout of the voxels
+	 * @param offset	position of the first voxel in voxels, to place the grid around a part of the scene (e.g. a fitted bounding box)
+	 * @param layout	order of the voxels in memory
+	 */
+	Model(int x, int y, int z, float size, ModelStorage storage = ModelStorage::Dense, cv::Vec3i offset = cv::Vec3i(0, 0, 0), VoxelLayout layout = VoxelLayout::Linear);
+
+	/**
+	 * @brief Number of elements of the per-voxel arrays of a grid of x * y * z voxels in the given layout (bricks and padded rows and slices included).
+	 */
+	static size_t voxelCount(int x, int y, int z, VoxelLayout layout);
+
+	/**
+	 * @brief Bytes of the per-voxel storage of a grid of x * y * z voxels, colors of compact models are not included.
+	 * Sparse models are estimated with all bricks allocated and colored. The padding of the layout is included (sparse and mapped models are always linear).
+	 */
+	static size_t memorySize(int x, int y, int z, ModelStorage storage, VoxelLayout layout = VoxelLayout::Linear);
+
+	// the voxel accessors resolve storage and layout for every call and run the code of VoxelAccess (defined after it),
+	// stages that visit many voxels resolve them once with dispatchVoxelAccess
 	void set(int x, int y, int z, const Vector4f& v);
 	void set(cv::Vec3i voxel, const Vector4f& value) {
 		set(voxel(0), voxel(1), voxel(2), value);
@@ -115,51 +352,476 @@ public:
 	int getY() { return size_y; }
 	int getZ() { return size_z; }
 	float getSize() { return voxel_size; }
+	ModelStorage getStorage() { return storage; }
+	VoxelLayout getLayout() { return layout; }
+	bool hasGhostLayer() { return layout == VoxelLayout::Padded; }
+	cv::Vec3i getOffset() { return offset; }
 
-	Vector4f get(int x, int y, int z) {
-		if (x < 0 || x >= size_x || y < 0 || y >= size_y || z < 0 || z >= size_z) {
-			return Vector4f(0, 0, 0, 0);
-		}
-		return voxels[flatten(x, y, z)];
-	}
+	Vector4f get(int x, int y, int z);
 
-	bool isInner(int x, int y, int z) {
-		return (
-			get(x - 1, y, z)(3) != 0 && get(x + 1, y, z)(3) != 0 &&
-			get(x, y - 1, z)(3) != 0 && get(x, y + 1, z)(3) != 0 &&
-			get(x, y, z - 1)(3) != 0 && get(x, y, z + 1)(3) != 0
-			);
-	}
+	/**
+	 * @brief Like get, but the voxel has to lie within the grid (or its ghost layer for padded models).
+	 */
+	Vector4f getUnchecked(int x, int y, int z);
+
+	/**
+	 * @brief Whether the voxel is part of the model (alpha != 0), voxels outside of the grid are not.
+	 */
+	bool isOccupied(int x, int y, int z);
+
+	/**
+	 * @brief Like isOccupied, but the voxel has to lie within the grid (or its ghost layer for padded models).
+	 */
+	bool isOccupiedUnchecked(int x, int y, int z);
+
+	/**
+	 * @brief Like get for voxels at most MODEL_GHOST_LAYER voxels outside of the grid, padded models read them without bounds checks.
+	 */
+	Vector4f getNear(int x, int y, int z);
+
+	bool isInner(int x, int y, int z);
 
 	cv::Vec4f toWord(int x, int y, int z) {
-		return cv::Vec4f(y * voxel_size, x * voxel_size, -1 * z * voxel_size, 1);
+		return cv::Vec4f((y + offset(1)) * voxel_size, (x + offset(0)) * voxel_size, -1 * (z + offset(2)) * voxel_size, 1);
 	}
 
 	cv::Vec4f toWord(cv::Vec3i v) {
-		return cv::Vec4f(v(1) * voxel_size, v(0) * voxel_size, -1 * v(2) * voxel_size, 1);
+		return toWord(v(0), v(1), v(2));
 	}
 
-	void addColor(int x, int y, int z, const Vector4f& color, float depth) {
-		DCLR c = { color, depth };
-		colors[flatten(x, y, z)].push_back(c);
-	};
+	/**
+	 * @brief Start of the x-row (y, z) its voxels are projected from (CameraView::projectRow, CameraView::projectRowPoint): the voxel centre
+	 * at x = 0 of the lattice anchored at the world origin, voxel x is point rowPoint(x) of the row. Every stage projects voxels this way,
+	 * so they all get the same pixel for a voxel, also models over a part of a grid (fitted or tiled) and the whole grid.
+	 */
+	cv::Vec4f rowStart(int y, int z) {
+		return toWord(-offset(0), y, z);
+	}
+
+	cv::Vec4f rowStep() {
+		return cv::Vec4f(0, voxel_size, 0, 0);
+	}
+
+	int rowPoint(int x) {
+		return x + offset(0);
+	}
+
+	/**
+	 * @brief Enables the fractional coverage of the voxels (all voxels start fully covered).
+	 * Carving lowers it to the smallest share of foreground pixels a voxel has in any view, marching cubes uses it to place the surface between voxels.
+	 */
+	void enableCoverage();
+	bool hasCoverage() { return !coverage.empty(); }
 
-	std::vector<DCLR> getColors(int x, int y, int z) {
-		return colors[flatten(x, y, z)];
+	/**
+	 * @brief Fractional coverage of the voxel, occupancy (0 or 1) if the model has no coverage. Voxels outside of the grid are not covered.
+	 */
+	float getCoverage(int x, int y, int z);
+
+	/**
+	 * @brief Lowers the coverage of the voxel to the given value if it is smaller.
+	 */
+	void updateCoverage(int x, int y, int z, float value) {
+		float& current = coverage[flatten(x, y, z)];
+		current = std::min(current, value);
+	}
+
+	/**
+	 * @brief Enables the carve record, which keeps for every voxel how many views carved it and which of the first 64 views did.
+	 * Views can then be removed or a voting rule applied afterwards without projecting the voxels again.
+	 */
+	void enableCarveRecord();
+	bool hasCarveRecord() { return !carveCounts.empty(); }
+
+	/**
+	 * @brief Records that the view carved the voxel. Concurrent calls have to be for different voxels.
+	 */
+	void recordCarve(int x, int y, int z, int view) {
+		size_t i = flatten(x, y, z);
+		if (carveCounts[i] < UINT16_MAX) {
+			carveCounts[i]++;
+		}
+		if (view < 64) {
+			carveViews[i] |= uint64_t(1) << view;
+		}
+	}
+
+	int getCarveCount(int x, int y, int z) { return carveCounts[flatten(x, y, z)]; }
+	uint64_t getCarveViews(int x, int y, int z) { return carveViews[flatten(x, y, z)]; }
+
+	/**
+	 * @brief Recomputes the occupancy from the carve record in a single pass over the grid.
+	 * Voxels that are not carved anymore are restored with the model color, so this has to happen before color reconstruction.
+	 *
+	 * @param minViews		number of views that have to carve a voxel to remove it (1 is the standard carving)
+	 * @param removedViews	bitmask of the views (index < 64) whose carving is undone, they are removed from the record
+	 * @return int			number of voxels whose occupancy changed
+	 */
+	int applyCarveRecord(int minViews = 1, uint64_t removedViews = 0);
+
+	/**
+	 * @brief Origins (first voxel) of the bricks of MODEL_BRICK_SIZE^3 voxels that can hold occupied voxels, ordered by z, y and x.
+	 * These are all bricks of the grid unless the model is sparse and has been carved, then only the allocated bricks.
+	 * Bricks at the end of the grid are cut off by the grid.
+	 *
+	 * @param margin	also returns the bricks of the grid within this many bricks of them
+	 * @return std::vector<cv::Vec3i>	brick origins
+	 */
+	std::vector<cv::Vec3i> getBricks(int margin = 0);
+
+	/**
+	 * @brief Last voxel (exclusive) of the brick with the given origin.
+	 */
+	cv::Vec3i brickEnd(cv::Vec3i origin) {
+		return cv::Vec3i(std::min(origin(0) + MODEL_BRICK_SIZE, size_x), std::min(origin(1) + MODEL_BRICK_SIZE, size_y), std::min(origin(2) + MODEL_BRICK_SIZE, size_z));
 	}
 
-	void see(int x, int y, int z) { seen[flatten(x, y, z)] = true; }
+	/**
+	 * @brief Allocates the given bricks of a sparse model that has not been carved yet (with all voxels occupied), all other voxels are carved.
+	 */
+	void allocateBricks(const std::vector<cv::Vec3i>& origins);
+	bool hasImplicitBricks() { return storage == ModelStorage::Sparse && implicitBricks; }
+
+	/**
+	 * @brief Frees the bricks of a sparse model that have no occupied voxel left.
+	 *
+	 * @return int	number of bricks that are still allocated
+	 */
+	int releaseEmptyBricks();
+
+	void see(int x, int y, int z);
+
+	/**
+	 * @brief Whether the voxel lies within any view, voxels of missing bricks of carved sparse models have been carved and are seen.
+	 */
+	bool isSeen(int x, int y, int z);
+
 	void handleUnseen();
 
-	void visit(cv::Vec3i v) {
-		see(v(0), v(1), v(2));
+	/**
+	 * @brief Marks the voxel as visited (and seen).
+	 *
+	 * @return true		if the voxel had not been visited before, only one of several concurrent calls gets true
+	 */
+	bool visit(cv::Vec3i v) {
+		if (storage == ModelStorage::Sparse) {
+			VoxelBrick* brick = findBrick(v(0), v(1), v(2));
+			if (!brick) {
+				return false;
+			}
+			uint64_t bit = brickBit(v(0), v(1));
+			return !(brick->seen[v(2) & (MODEL_BRICK_SIZE - 1)].fetch_or(bit, std::memory_order_relaxed) & bit);
+		}
+		return !seen.testAndSet(flatten(v(0), v(1), v(2)));
 	}
 
 	bool visited(cv::Vec3i v) {
-		return seen[flatten(v(0), v(1), v(2))];
+		return isSeen(v(0), v(1), v(2));
 	}
+	/**
+	 * @brief Views (image files) that have been carved into the model with their poses, stored in snapshots.
+	 */
+	std::vector<AppliedView>& getAppliedViews() { return appliedViews; }
+
+	/**
+	 * @brief Sets the calibration the poses of the applied views are estimated with, stored in snapshots.
+	 */
+	void setCalibration(const cv::Mat& cameraMatrix, const cv::Mat& distCoeffs);
+
+	/**
+	 * @brief Whether the poses of the applied views have been estimated with the given calibration, false if the calibration is unknown.
+	 */
+	bool hasCalibration(const cv::Mat& cameraMatrix, const cv::Mat& distCoeffs);
+
 	std::string to_string();
 	bool WriteModel(const std::string& filename = "./out/model_mesh.off");
+
+	/**
+	 * @brief Writes the model to a binary snapshot file, which ReadSnapshot maps without parsing (any storage can be written).
+	 * Layout (host byte order): header (magic "AVXSNAP", version, dimensions, voxel size, offset, section offsets, calibration), then
+	 * the occupancy bits and the seen bits (64 bit words, voxel x + X * (y + Y * z) is bit i % 64 of word i / 64), one RGBA8 color per voxel
+	 * and the applied views (32 bit length and characters of the name, whether the pose is known, image size and 3x4 pose each). The bit and color sections start at page boundaries. Coverage and carve record are not part of the snapshot, alpha values are reduced to 8 bits.
+	 * The file is written to filename.tmp and renamed to filename when it is complete, so a model resumed from filename can write it again.
+	 *
+	 * @param filename	path of the snapshot file
+	 * @return bool		whether the snapshot was written
+	 */
+	bool WriteSnapshot(const std::string& filename);
+
+	/**
+	 * @brief Maps a snapshot written by WriteSnapshot in constant time (mapped storage), voxels are read from the file when they are accessed.
+	 * The model can be carved, colored and closed like any other, the file is never changed.
+	 *
+	 * @param filename					path of the snapshot file
+	 * @return std::unique_ptr<Model>	the model, nullptr if the file is no valid snapshot
+	 */
+	static std::unique_ptr<Model> ReadSnapshot(const std::string& filename);
+};
+
+/**
+ * @brief Voxel accessors of a model whose storage and layout are resolved at compile time, the only implementation of the storages.
+ * The per-voxel stages (VoxelPass, the standard carving, the closure and marching cubes) are templates over the accessor and are instantiated for every
+ * storage and layout, dispatchVoxelAccess selects the instantiation once per pass. Reading or writing a voxel is then the index computation (shifts and adds
+ * for padded models, whose neighbours are read without bounds checks) and a single load or store. The voxel accessors of Model dispatch every call.
+ * Views are only valid as long as the per-voxel arrays of the model are not reallocated (enableCoverage and enableCarveRecord are called before).
+ *
+ * @tparam Storage	storage of the model
+ * @tparam Layout	layout of the model (sparse and mapped models are linear)
+ */
+template <ModelStorage Storage, VoxelLayout Layout>
+class VoxelAccess {
+private:
+	Model& model;
+	Vector4f* voxels;
+	uint8_t* packedVoxels;
+	const int size_x;
+	const int size_y;
+	const int size_z;
+
+	bool contains(int x, int y, int z) const {
+		return x >= 0 && x < size_x && y >= 0 && y < size_y && z >= 0 && z < size_z;
+	}
+
+public:
+	explicit VoxelAccess(Model& model) : model(model), voxels(model.voxels.data()), packedVoxels(model.packedVoxels.data()),
+		size_x(model.getX()), size_y(model.getY()), size_z(model.getZ()) {}
+
+	int getX() const { return size_x; }
+	int getY() const { return size_y; }
+	int getZ() const { return size_z; }
+	static constexpr ModelStorage getStorage() { return Storage; }
+	static constexpr VoxelLayout getLayout() { return Layout; }
+	cv::Vec4f toWord(int x, int y, int z) { return model.toWord(x, y, z); }
+	cv::Vec4f rowStart(int y, int z) { return model.rowStart(y, z); }
+	cv::Vec4f rowStep() { return model.rowStep(); }
+	int rowPoint(int x) { return model.rowPoint(x); }
+	std::vector<cv::Vec3i> getBricks(int margin = 0) { return model.getBricks(margin); }
+	cv::Vec3i brickEnd(cv::Vec3i origin) { return model.brickEnd(origin); }
+
+	size_t index(int x, int y, int z) { return model.template flattenAs<Layout>(x, y, z); }
+
+	Vector4f getUnchecked(int x, int y, int z) {
+		if constexpr (Storage == ModelStorage::Sparse) {
+			return model.getSparse(x, y, z);
+		}
+		else if constexpr (Storage == ModelStorage::Compact) {
+			return model.getCompact(index(x, y, z));
+		}
+		else if constexpr (Storage == ModelStorage::Mapped) {
+			return model.getMapped(index(x, y, z));
+		}
+		else if constexpr (Storage == ModelStorage::RGBA8) {
+			return unpackVoxel(packedVoxels + 4 * index(x, y, z));
+		}
+		else {
+			return voxels[index(x, y, z)];
+		}
+	}
+
+	Vector4f get(int x, int y, int z) {
+		return contains(x, y, z) ? getUnchecked(x, y, z) : Vector4f(0, 0, 0, 0);
+	}
+
+	Vector4f getNear(int x, int y, int z) {
+		if constexpr (Layout == VoxelLayout::Padded) {
+			return getUnchecked(x, y, z);
+		}
+		else {
+			return get(x, y, z);
+		}
+	}
+
+	bool isOccupiedUnchecked(int x, int y, int z) {
+		if constexpr (Storage == ModelStorage::Sparse) {
+			return model.isOccupiedSparse(x, y, z);
+		}
+		else if constexpr (Storage == ModelStorage::RGBA8) {
+			return packedVoxels[4 * index(x, y, z) + 3] != 0;
+		}
+		else if constexpr (Storage == ModelStorage::Dense) {
+			return voxels[index(x, y, z)](3) != 0;
+		}
+		else {
+			return model.occupied.test(index(x, y, z));
+		}
+	}
+
+	bool isOccupied(int x, int y, int z) {
+		return contains(x, y, z) && isOccupiedUnchecked(x, y, z);
+	}
+
+	bool isInner(int x, int y, int z) {
+		// neighbours outside of the grid are never occupied, padded models have them in their ghost layer
+		if (Layout != VoxelLayout::Padded && (x <= 0 || x >= size_x - 1 || y <= 0 || y >= size_y - 1 || z <= 0 || z >= size_z - 1)) {
+			return false;
+		}
+		return (
+			isOccupiedUnchecked(x - 1, y, z) && isOccupiedUnchecked(x + 1, y, z) &&
+			isOccupiedUnchecked(x, y - 1, z) && isOccupiedUnchecked(x, y + 1, z) &&
+			isOccupiedUnchecked(x, y, z - 1) && isOccupiedUnchecked(x, y, z + 1)
+			);
+	}
+
+	/**
+	 * @brief Sets a voxel of the per-voxel arrays by its index (all but sparse storage).
+	 */
+	void setIndex(size_t i, const Vector4f& v) {
+		static_assert(Storage != ModelStorage::Sparse, "sparse models have no per-voxel arrays");
+		if constexpr (Storage == ModelStorage::Compact) {
+			model.setCompact(i, v);
+		}
+		else if constexpr (Storage == ModelStorage::Mapped) {
+			model.setMapped(i, v);
+		}
+		else if constexpr (Storage == ModelStorage::RGBA8) {
+			model.setPacked(i, v);
+		}
+		else {
+			voxels[i] = v;
+		}
+	}
+
+	void set(int x, int y, int z, const Vector4f& v) {
+		if constexpr (Storage == ModelStorage::Sparse) {
+			model.setSparse(x, y, z, v);
+		}
+		else {
+			setIndex(index(x, y, z), v);
+		}
+	}
+	void set(cv::Vec3i voxel, const Vector4f& value) {
+		set(voxel(0), voxel(1), voxel(2), value);
+	}
+
+	void see(int x, int y, int z) {
+		if constexpr (Storage == ModelStorage::Sparse) {
+			model.seeSparse(x, y, z);
+		}
+		else {
+			model.seen.set(index(x, y, z));
+		}
+	}
+
+	bool isSeen(int x, int y, int z) {
+		if constexpr (Storage == ModelStorage::Sparse) {
+			return model.isSeenSparse(x, y, z);
+		}
+		else {
+			return model.seen.test(index(x, y, z));
+		}
+	}
+
+	bool hasCoverage() { return model.hasCoverage(); }
+	float getCoverage(int x, int y, int z) {
+		if (!contains(x, y, z)) {
+			return 0;
+		}
+		if (!hasCoverage()) {
+			return isOccupiedUnchecked(x, y, z) ? 1.f : 0.f;
+		}
+		return model.coverage[index(x, y, z)];
+	}
+	void updateCoverage(int x, int y, int z, float value) {
+		float& current = model.coverage[index(x, y, z)];
+		current = std::min(current, value);
+	}
+
+	bool hasCarveRecord() { return model.hasCarveRecord(); }
+	void recordCarve(int x, int y, int z, int view) { model.recordCarve(x, y, z, view); }
 };
 
+/**
+ * @brief Calls body with the VoxelAccess of the given storage and the layout of the model and returns its result.
+ */
+template <ModelStorage Storage, class Body>
+auto dispatchVoxelLayout(Model& model, Body&& body) {
+	switch (model.getLayout()) {
+	case VoxelLayout::Bricked: {
+		VoxelAccess<Storage, VoxelLayout::Bricked> access(model);
+		return body(access);
+	}
+	case VoxelLayout::Padded: {
+		VoxelAccess<Storage, VoxelLayout::Padded> access(model);
+		return body(access);
+	}
+	default: {
+		VoxelAccess<Storage, VoxelLayout::Linear> access(model);
+		return body(access);
+	}
+	}
+}
+
+/**
+ * @brief Calls body once with the VoxelAccess of the storage and layout of the model and returns its result, the model must not be sparse.
+ * body is a generic lambda (or functor) taking the accessor as auto&, it is only instantiated for the storages with per-voxel arrays.
+ */
+template <class Body>
+auto dispatchVoxelArrays(Model& model, Body&& body) {
+	switch (model.getStorage()) {
+	case ModelStorage::Compact:
+		return dispatchVoxelLayout<ModelStorage::Compact>(model, body);
+	case ModelStorage::Mapped: {
+		VoxelAccess<ModelStorage::Mapped, VoxelLayout::Linear> access(model);
+		return body(access);
+	}
+	case ModelStorage::RGBA8:
+		return dispatchVoxelLayout<ModelStorage::RGBA8>(model, body);
+	default:
+		return dispatchVoxelLayout<ModelStorage::Dense>(model, body);
+	}
+}
+
+/**
+ * @brief Calls body once with the VoxelAccess of the storage and layout of the model and returns its result.
+ * body is a generic lambda (or functor) taking the accessor as auto&.
+ */
+template <class Body>
+auto dispatchVoxelAccess(Model& model, Body&& body) {
+	if (model.getStorage() == ModelStorage::Sparse) {
+		VoxelAccess<ModelStorage::Sparse, VoxelLayout::Linear> access(model);
+		return body(access);
+	}
+	return dispatchVoxelArrays(model, body);
+}
+
+inline Vector4f Model::get(int x, int y, int z) {
+	return dispatchVoxelAccess(*this, [&](auto& grid) { return grid.get(x, y, z); });
+}
+
+inline Vector4f Model::getUnchecked(int x, int y, int z) {
+	return dispatchVoxelAccess(*this, [&](auto& grid) { return grid.getUnchecked(x, y, z); });
+}
+
+inline Vector4f Model::getNear(int x, int y, int z) {
+	return dispatchVoxelAccess(*this, [&](auto& grid) { return grid.getNear(x, y, z); });
+}
+
+inline bool Model::isOccupied(int x, int y, int z) {
+	return dispatchVoxelAccess(*this, [&](auto& grid) { return grid.isOccupied(x, y, z); });
+}
+
+inline bool Model::isOccupiedUnchecked(int x, int y, int z) {
+	return dispatchVoxelAccess(*this, [&](auto& grid) { return grid.isOccupiedUnchecked(x, y, z); });
+}
+
+inline bool Model::isInner(int x, int y, int z) {
+	return dispatchVoxelAccess(*this, [&](auto& grid) { return grid.isInner(x, y, z); });
+}
+
+inline void Model::set(int x, int y, int z, const Vector4f& v) {
+	dispatchVoxelAccess(*this, [&](auto& grid) { grid.set(x, y, z, v); });
+}
+
+inline void Model::see(int x, int y, int z) {
+	dispatchVoxelAccess(*this, [&](auto& grid) { grid.see(x, y, z); });
+}
+
+inline bool Model::isSeen(int x, int y, int z) {
+	return dispatchVoxelAccess(*this, [&](auto& grid) { return grid.isSeen(x, y, z); });
+}
+
+inline float Model::getCoverage(int x, int y, int z) {
+	return dispatchVoxelAccess(*this, [&](auto& grid) { return grid.getCoverage(x, y, z); });
+}
+
 #endif
@@ -1,99 +1,127 @@
 #include "Postprocessing3d.h"
 #include "Benchmark.h"
+#include <algorithm>
 #include <iostream>
-int applyClosure(Model* model, int kernelSize) {
-	std::cout << "LOG - PP: starting postprocessing." << std::endl;
-	Benchmark::GetInstance().LogPostProcessing(true);
+
+/**
+ * @brief Dilutes the occupied voxels of model into temp and erodes them back into model, both within the given bricks.
+ *
+ * @param model		accessor of the voxel grid to close
+ * @param temp		accessor of an empty grid of the same size
+ * @param bricks	bricks within the kernel of occupied voxels
+ * @param size		half of the kernel size
+ */
+template <class Grid, class TempGrid>
+static void closeGrid(Grid& model, TempGrid& temp, const std::vector<cv::Vec3i>& bricks, int size) {
 	float thresh = 0;
-	if (kernelSize % 2 != 1) {
-		std::cerr << "Invalid kernel size for post processing, skipping..." << std::endl;
-		return -1;
-	}
-	int size = (kernelSize-1)/2;
-	int x_size = model->getX();
-	int y_size = model->getY();
-	int z_size = model->getZ();
-	Model temp(x_size, y_size, z_size,1.f);
+	int x_size = model.getX();
+	int y_size = model.getY();
+	int z_size = model.getZ();
 	std::cout << "LOG - PP: starting dilution." << std::endl;
 	int counter = 0;
 	//dilution
-	for (int x = 0; x < x_size; x++) {
-		for (int y = 0; y < y_size; y++) {
-			for (int z = 0; z < z_size; z++) {
-				Vector4f origin_v = model->get(x, y, z);
-				if (origin_v.w() > thresh) {
-					counter++;
-					temp.set(x, y, z, origin_v);
-					continue;
-				}
-				int count = 0;
-				Vector4f sum(0, 0, 0, 0);
-				for (int i = -size; i <= size; i++) {
-					int x_n = x + i;
-					//std::cout << "hello? " << size << std::endl;
-					if (x_n < 0 || x_n >= x_size) continue;
-					for (int j = -size; j <= size; j++) {
-						int y_n = y + j;
-						if (y_n < 0 || y_n >= y_size) continue;
-						for (int k = -size; k <= size; k++) {
-							int z_n = z + k;
-							if (z_n < 0 || z_n >= z_size) continue;
-							//std::cout << "miracle" << std::endl;
-							Vector4f val = model->get(x_n, y_n, z_n);
-							if (val.w() > thresh) {
-								count++;
-								sum = sum + val;
+	for (const cv::Vec3i& brick : bricks) {
+		cv::Vec3i end = model.brickEnd(brick);
+		for (int z = brick(2); z < end(2); z++) {
+			for (int y = brick(1); y < end(1); y++) {
+				for (int x = brick(0); x < end(0); x++) {
+					Vector4f origin_v = model.getUnchecked(x, y, z);
+					if (origin_v.w() > thresh) {
+						counter++;
+						temp.set(x, y, z, origin_v);
+						continue;
+					}
+					int count = 0;
+					Vector4f sum(0, 0, 0, 0);
+					// the kernel is cut off by the grid once per voxel, so its voxels are read without bounds checks
+					int i_end = std::min(size, x_size - 1 - x), j_end = std::min(size, y_size - 1 - y), k_end = std::min(size, z_size - 1 - z);
+					for (int k = std::max(-size, -z); k <= k_end; k++) {
+						int z_n = z + k;
+						for (int j = std::max(-size, -y); j <= j_end; j++) {
+							int y_n = y + j;
+							for (int i = std::max(-size, -x); i <= i_end; i++) {
+								int x_n = x + i;
+								Vector4f val = model.getUnchecked(x_n, y_n, z_n);
+								if (val.w() > thresh) {
+									count++;
+									sum = sum + val;
+								}
 							}
 						}
 					}
+					if (count > 0) {
+						sum /= count;
+						//std::cout << "count was > 0" << std::endl;
+					}
+					//std::cout << "from " << temp.get(x, y, z) << " to " << sum << std::endl;
+					temp.set(x, y, z, sum);
 				}
-				if (count > 0) {
-					sum /= count;
-					//std::cout << "count was > 0" << std::endl;
-				}
-				//std::cout << "from " << temp.get(x, y, z) << " to " << sum << std::endl;
-				temp.set(x, y, z, sum);
 			}
 		}
 	}
 	//erosion
 	std::cout << "LOG - PP: starting erosion." << std::endl;
-	for (int x = 0; x < x_size; x++) {
-		for (int y = 0; y < y_size; y++) {
-			for (int z = 0; z < z_size; z++) {
-				Vector4f zero(0, 0, 0, 0);
-				bool failed = false;
-				Vector4f temp_v = model->get(x, y, z);
-				if (temp_v.w() < thresh) {
-					model->set(x, y, z, temp_v);
-					continue;
-				}
-				for (int i = -size; i <= size; i++) {
-					int x_n = x + i;
-					if (x_n < 0 || x_n >= x_size) continue;
-					for (int j = -size; j <= size; j++) {
-						int y_n = y + j;
-						if (y_n < 0 || y_n >= y_size) continue;
-						for (int k = -size; k <= size; k++) {
-							int z_n = z + k;
-							if (z_n < 0 || z_n >= z_size) continue;
-							Vector4f val = temp.get(x_n, y_n, z_n);
-							if (val.w() < thresh) {
-								failed = true;
-								i = j = k = size + 1;
+	for (const cv::Vec3i& brick : bricks) {
+		cv::Vec3i end = model.brickEnd(brick);
+		for (int z = brick(2); z < end(2); z++) {
+			for (int y = brick(1); y < end(1); y++) {
+				for (int x = brick(0); x < end(0); x++) {
+					Vector4f zero(0, 0, 0, 0);
+					bool failed = false;
+					Vector4f temp_v = model.getUnchecked(x, y, z);
+					if (temp_v.w() < thresh) {
+						model.set(x, y, z, temp_v);
+						continue;
+					}
+					int i_end = std::min(size, x_size - 1 - x), j_end = std::min(size, y_size - 1 - y), k_end = std::min(size, z_size - 1 - z);
+					for (int k = std::max(-size, -z); k <= k_end; k++) {
+						int z_n = z + k;
+						for (int j = std::max(-size, -y); j <= j_end; j++) {
+							int y_n = y + j;
+							for (int i = std::max(-size, -x); i <= i_end; i++) {
+								int x_n = x + i;
+								Vector4f val = temp.getUnchecked(x_n, y_n, z_n);
+								if (val.w() < thresh) {
+									failed = true;
+									i = j = k = size + 1;
+								}
 							}
 						}
 					}
-				}
-				if (failed) {
-					model->set(x, y, z, zero);
-				}
-				else {
-					model->set(x, y, z, temp.get(x, y, z));
+					if (failed) {
+						model.set(x, y, z, zero);
+					}
+					else {
+						model.set(x, y, z, temp.getUnchecked(x, y, z));
+					}
 				}
 			}
 		}
 	}
+}
+
+int applyClosure(Model* model, int kernelSize) {
+	std::cout << "LOG - PP: starting postprocessing." << std::endl;
+	Benchmark::GetInstance().LogPostProcessing(true);
+	if (kernelSize % 2 != 1) {
+		std::cerr << "Invalid kernel size for post processing, skipping..." << std::endl;
+		return -1;
+	}
+	int size = (kernelSize-1)/2;
+	// mapped models only come from snapshots, their temp grid is kept bit-packed instead
+	Model temp(model->getX(), model->getY(), model->getZ(), 1.f, model->getStorage() == ModelStorage::Mapped ? ModelStorage::Compact : model->getStorage(), cv::Vec3i(0, 0, 0), model->getLayout());
+	if (temp.hasImplicitBricks()) {
+		// a sparse temp grid starts empty, voxels outside of the visited bricks are never set
+		temp.allocateBricks(std::vector<cv::Vec3i>());
+	}
+	// only bricks within the kernel of occupied voxels can change
+	std::vector<cv::Vec3i> bricks = model->getBricks((size + MODEL_BRICK_SIZE - 1) / MODEL_BRICK_SIZE);
+	// storage and layout are resolved once for the closure, the temp grid has those of the model (mapped models are linear)
+	dispatchVoxelAccess(*model, [&](auto& grid) {
+		constexpr ModelStorage storage = std::decay_t<decltype(grid)>::getStorage();
+		VoxelAccess<storage == ModelStorage::Mapped ? ModelStorage::Compact : storage, std::decay_t<decltype(grid)>::getLayout()> tempGrid(temp);
+		closeGrid(grid, tempGrid, bricks, size);
+	});
 	Benchmark::GetInstance().LogPostProcessing(false);
 	std::cout << "LOG - PP: postprocessing completed." << std::endl;
 	return 0;
@@ -0,0 +1,194 @@
+#include "Projection.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define PROJECTION_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PROJECTION_SSE2
+#endif
+
+static inline float dot(const float* row, const cv::Vec4f& v) {
+	return row[0] * v[0] + row[1] * v[1] + row[2] * v[2] + row[3] * v[3];
+}
+
+#if defined(PROJECTION_AVX2)
+
+// std::round for packed floats: truncate, then correct by one where the remainder is at least one half.
+// Coordinates the scalar roundToPixel maps to INT_MIN (|coord| >= 2e9 or NaN) are set to exactly INT_MIN, cvtt would wrap them
+static inline __m256i roundToPixel(__m256 coord) {
+	__m256i truncated = _mm256_cvttps_epi32(coord);
+	__m256 remainder = _mm256_sub_ps(coord, _mm256_cvtepi32_ps(truncated));
+	__m256i up = _mm256_castps_si256(_mm256_cmp_ps(remainder, _mm256_set1_ps(0.5f), _CMP_GE_OQ));
+	__m256i down = _mm256_castps_si256(_mm256_cmp_ps(remainder, _mm256_set1_ps(-0.5f), _CMP_LE_OQ));
+	__m256i rounded = _mm256_add_epi32(_mm256_sub_epi32(truncated, up), down);
+	__m256 magnitude = _mm256_andnot_ps(_mm256_set1_ps(-0.f), coord);
+	__m256i valid = _mm256_castps_si256(_mm256_cmp_ps(magnitude, _mm256_set1_ps(2.0e9f), _CMP_LT_OQ));
+	return _mm256_blendv_epi8(_mm256_set1_epi32(INT_MIN), rounded, valid);
+}
+
+#elif defined(PROJECTION_SSE2)
+
+// std::round for packed floats: truncate, then correct by one where the remainder is at least one half.
+// Coordinates the scalar roundToPixel maps to INT_MIN (|coord| >= 2e9 or NaN) are set to exactly INT_MIN, cvtt would wrap them
+static inline __m128i roundToPixel(__m128 coord) {
+	__m128i truncated = _mm_cvttps_epi32(coord);
+	__m128 remainder = _mm_sub_ps(coord, _mm_cvtepi32_ps(truncated));
+	__m128i up = _mm_castps_si128(_mm_cmpge_ps(remainder, _mm_set1_ps(0.5f)));
+	__m128i down = _mm_castps_si128(_mm_cmple_ps(remainder, _mm_set1_ps(-0.5f)));
+	__m128i rounded = _mm_add_epi32(_mm_sub_epi32(truncated, up), down);
+	__m128 magnitude = _mm_andnot_ps(_mm_set1_ps(-0.f), coord);
+	__m128i valid = _mm_castps_si128(_mm_cmplt_ps(magnitude, _mm_set1_ps(2.0e9f)));
+	return _mm_or_si128(_mm_and_si128(valid, rounded), _mm_andnot_si128(valid, _mm_set1_epi32(INT_MIN)));
+}
+
+#endif
+
+void projectRow(const cv::Mat& projection, const cv::Vec4f& start, const cv::Vec4f& step, int n, int* px, int* py, int first) {
+	const float* P = projection.ptr<float>();
+
+	// homogeneous image coordinates of point 0 and their increment per point
+	float u0 = dot(P, start), du = dot(P, step);
+	float v0 = dot(P + 4, start), dv = dot(P + 4, step);
+	float w0 = dot(P + 8, start), dw = dot(P + 8, step);
+
+	int k = 0;
+#if defined(PROJECTION_AVX2)
+	const __m256 lanes = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+	for (; k + 8 <= n; k += 8) {
+		__m256 kk = _mm256_add_ps(_mm256_set1_ps((float)(first + k)), lanes);
+		__m256 u = _mm256_add_ps(_mm256_set1_ps(u0), _mm256_mul_ps(kk, _mm256_set1_ps(du)));
+		__m256 v = _mm256_add_ps(_mm256_set1_ps(v0), _mm256_mul_ps(kk, _mm256_set1_ps(dv)));
+		__m256 w = _mm256_add_ps(_mm256_set1_ps(w0), _mm256_mul_ps(kk, _mm256_set1_ps(dw)));
+		_mm256_storeu_si256((__m256i*)(px + k), roundToPixel(_mm256_div_ps(u, w)));
+		_mm256_storeu_si256((__m256i*)(py + k), roundToPixel(_mm256_div_ps(v, w)));
+	}
+#elif defined(PROJECTION_SSE2)
+	const __m128 lanes = _mm_setr_ps(0, 1, 2, 3);
+	for (; k + 4 <= n; k += 4) {
+		__m128 kk = _mm_add_ps(_mm_set1_ps((float)(first + k)), lanes);
+		__m128 u = _mm_add_ps(_mm_set1_ps(u0), _mm_mul_ps(kk, _mm_set1_ps(du)));
+		__m128 v = _mm_add_ps(_mm_set1_ps(v0), _mm_mul_ps(kk, _mm_set1_ps(dv)));
+		__m128 w = _mm_add_ps(_mm_set1_ps(w0), _mm_mul_ps(kk, _mm_set1_ps(dw)));
+		_mm_storeu_si128((__m128i*)(px + k), roundToPixel(_mm_div_ps(u, w)));
+		_mm_storeu_si128((__m128i*)(py + k), roundToPixel(_mm_div_ps(v, w)));
+	}
+#endif
+	// portable fallback and remainder of the row
+	projectRowScalar(projection, start, step, n - k, px + k, py + k, first + k);
+}
+
+void projectRowScalar(const cv::Mat& projection, const cv::Vec4f& start, const cv::Vec4f& step, int n, int* px, int* py, int first) {
+	const float* P = projection.ptr<float>();
+	float u0 = dot(P, start), du = dot(P, step);
+	float v0 = dot(P + 4, start), dv = dot(P + 4, step);
+	float w0 = dot(P + 8, start), dw = dot(P + 8, step);
+	for (int k = 0; k < n; k++) {
+		float kk = (float)(first + k);
+		float u = u0 + kk * du;
+		float v = v0 + kk * dv;
+		float w = w0 + kk * dw;
+		px[k] = roundToPixel(u / w);
+		py[k] = roundToPixel(v / w);
+	}
+}
+
+void projectRow(const cv::Mat& pose, const LensModel& lens, const cv::Vec4f& start, const cv::Vec4f& step, int n, int* px, int* py, int first) {
+	const float* T = pose.ptr<float>();
+
+	// camera coordinates of point 0 and their increment per point
+	float X0 = dot(T, start), dX = dot(T, step);
+	float Y0 = dot(T + 4, start), dY = dot(T + 4, step);
+	float Z0 = dot(T + 8, start), dZ = dot(T + 8, step);
+
+	int k = 0;
+#if defined(PROJECTION_AVX2)
+	const __m256 lanes = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+	const __m256 one = _mm256_set1_ps(1), two = _mm256_set1_ps(2);
+	for (; k + 8 <= n; k += 8) {
+		__m256 kk = _mm256_add_ps(_mm256_set1_ps((float)(first + k)), lanes);
+		__m256 Z = _mm256_add_ps(_mm256_set1_ps(Z0), _mm256_mul_ps(kk, _mm256_set1_ps(dZ)));
+		__m256 x = _mm256_div_ps(_mm256_add_ps(_mm256_set1_ps(X0), _mm256_mul_ps(kk, _mm256_set1_ps(dX))), Z);
+		__m256 y = _mm256_div_ps(_mm256_add_ps(_mm256_set1_ps(Y0), _mm256_mul_ps(kk, _mm256_set1_ps(dY))), Z);
+
+		__m256 xx = _mm256_mul_ps(x, x), yy = _mm256_mul_ps(y, y), xy = _mm256_mul_ps(x, y);
+		__m256 r2 = _mm256_add_ps(xx, yy);
+		__m256 num = _mm256_add_ps(_mm256_set1_ps(lens.k2), _mm256_mul_ps(r2, _mm256_set1_ps(lens.k3)));
+		num = _mm256_add_ps(one, _mm256_mul_ps(r2, _mm256_add_ps(_mm256_set1_ps(lens.k1), _mm256_mul_ps(r2, num))));
+		__m256 den = _mm256_add_ps(_mm256_set1_ps(lens.k5), _mm256_mul_ps(r2, _mm256_set1_ps(lens.k6)));
+		den = _mm256_add_ps(one, _mm256_mul_ps(r2, _mm256_add_ps(_mm256_set1_ps(lens.k4), _mm256_mul_ps(r2, den))));
+		__m256 radial = _mm256_div_ps(num, den);
+
+		__m256 xd = _mm256_add_ps(_mm256_mul_ps(x, radial), _mm256_mul_ps(_mm256_set1_ps(2 * lens.p1), xy));
+		xd = _mm256_add_ps(xd, _mm256_mul_ps(_mm256_set1_ps(lens.p2), _mm256_add_ps(r2, _mm256_mul_ps(two, xx))));
+		__m256 yd = _mm256_add_ps(_mm256_mul_ps(y, radial), _mm256_mul_ps(_mm256_set1_ps(lens.p1), _mm256_add_ps(r2, _mm256_mul_ps(two, yy))));
+		yd = _mm256_add_ps(yd, _mm256_mul_ps(_mm256_set1_ps(2 * lens.p2), xy));
+		__m256 u = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(lens.fx), xd), _mm256_set1_ps(lens.cx));
+		__m256 v = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(lens.fy), yd), _mm256_set1_ps(lens.cy));
+
+		// points beyond the valid radius get a coordinate that rounds to INT_MIN like distortToPixel
+		__m256 valid = _mm256_cmp_ps(r2, _mm256_set1_ps(lens.maxRadius2), _CMP_LE_OQ);
+		u = _mm256_blendv_ps(_mm256_set1_ps(-4e9f), u, valid);
+		v = _mm256_blendv_ps(_mm256_set1_ps(-4e9f), v, valid);
+		_mm256_storeu_si256((__m256i*)(px + k), roundToPixel(u));
+		_mm256_storeu_si256((__m256i*)(py + k), roundToPixel(v));
+	}
+#elif defined(PROJECTION_SSE2)
+	const __m128 lanes = _mm_setr_ps(0, 1, 2, 3);
+	const __m128 one = _mm_set1_ps(1), two = _mm_set1_ps(2);
+	for (; k + 4 <= n; k += 4) {
+		__m128 kk = _mm_add_ps(_mm_set1_ps((float)(first + k)), lanes);
+		__m128 Z = _mm_add_ps(_mm_set1_ps(Z0), _mm_mul_ps(kk, _mm_set1_ps(dZ)));
+		__m128 x = _mm_div_ps(_mm_add_ps(_mm_set1_ps(X0), _mm_mul_ps(kk, _mm_set1_ps(dX))), Z);
+		__m128 y = _mm_div_ps(_mm_add_ps(_mm_set1_ps(Y0), _mm_mul_ps(kk, _mm_set1_ps(dY))), Z);
+
+		__m128 xx = _mm_mul_ps(x, x), yy = _mm_mul_ps(y, y), xy = _mm_mul_ps(x, y);
+		__m128 r2 = _mm_add_ps(xx, yy);
+		__m128 num = _mm_add_ps(_mm_set1_ps(lens.k2), _mm_mul_ps(r2, _mm_set1_ps(lens.k3)));
+		num = _mm_add_ps(one, _mm_mul_ps(r2, _mm_add_ps(_mm_set1_ps(lens.k1), _mm_mul_ps(r2, num))));
+		__m128 den = _mm_add_ps(_mm_set1_ps(lens.k5), _mm_mul_ps(r2, _mm_set1_ps(lens.k6)));
+		den = _mm_add_ps(one, _mm_mul_ps(r2, _mm_add_ps(_mm_set1_ps(lens.k4), _mm_mul_ps(r2, den))));
+		__m128 radial = _mm_div_ps(num, den);
+
+		__m128 xd = _mm_add_ps(_mm_mul_ps(x, radial), _mm_mul_ps(_mm_set1_ps(2 * lens.p1), xy));
+		xd = _mm_add_ps(xd, _mm_mul_ps(_mm_set1_ps(lens.p2), _mm_add_ps(r2, _mm_mul_ps(two, xx))));
+		__m128 yd = _mm_add_ps(_mm_mul_ps(y, radial), _mm_mul_ps(_mm_set1_ps(lens.p1), _mm_add_ps(r2, _mm_mul_ps(two, yy))));
+		yd = _mm_add_ps(yd, _mm_mul_ps(_mm_set1_ps(2 * lens.p2), xy));
+		__m128 u = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(lens.fx), xd), _mm_set1_ps(lens.cx));
+		__m128 v = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(lens.fy), yd), _mm_set1_ps(lens.cy));
+
+		// points beyond the valid radius get a coordinate that rounds to INT_MIN like distortToPixel (SSE2 has no blend)
+		__m128 valid = _mm_cmple_ps(r2, _mm_set1_ps(lens.maxRadius2));
+		u = _mm_or_ps(_mm_and_ps(valid, u), _mm_andnot_ps(valid, _mm_set1_ps(-4e9f)));
+		v = _mm_or_ps(_mm_and_ps(valid, v), _mm_andnot_ps(valid, _mm_set1_ps(-4e9f)));
+		_mm_storeu_si128((__m128i*)(px + k), roundToPixel(u));
+		_mm_storeu_si128((__m128i*)(py + k), roundToPixel(v));
+	}
+#endif
+	// portable fallback and remainder of the row
+	projectRowScalar(pose, lens, start, step, n - k, px + k, py + k, first + k);
+}
+
+void projectRowScalar(const cv::Mat& pose, const LensModel& lens, const cv::Vec4f& start, const cv::Vec4f& step, int n, int* px, int* py, int first) {
+	const float* T = pose.ptr<float>();
+	float X0 = dot(T, start), dX = dot(T, step);
+	float Y0 = dot(T + 4, start), dY = dot(T + 4, step);
+	float Z0 = dot(T + 8, start), dZ = dot(T + 8, step);
+	for (int k = 0; k < n; k++) {
+		float kk = (float)(first + k);
+		float Z = Z0 + kk * dZ;
+		cv::Point pixel = distortToPixel(lens, (X0 + kk * dX) / Z, (Y0 + kk * dY) / Z);
+		px[k] = pixel.x;
+		py[k] = pixel.y;
+	}
+}
+
+const char* projectionKernel() {
+#if defined(PROJECTION_AVX2)
+	return "AVX2";
+#elif defined(PROJECTION_SSE2)
+	return "SSE2";
+#else
+	return "portable";
+#endif
+}
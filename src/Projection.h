@@ -0,0 +1,156 @@
+#pragma once
+
+#ifndef PROJECTION_H
+#define PROJECTION_H
+
+#include <cmath>
+#include <climits>
+#include <opencv2/core/mat.hpp>
+
+/**
+ * @brief Rounds a projected coordinate to the nearest pixel (halfway cases away from zero like std::round).
+ * Coordinates that do not fit into an int (e.g. points on the camera plane) are mapped to INT_MIN, which lies outside every image.
+ *
+ * @param coord		projected coordinate
+ * @return int		pixel coordinate
+ */
+static inline int roundToPixel(float coord) {
+	if (!(std::fabs(coord) < 2.0e9f)) {
+		return INT_MIN;
+	}
+	return (int)std::round(coord);
+}
+
+/**
+ * @brief This function projects a single point into a view without allocating any matrices.
+ *
+ * @param projection	3x4 projection matrix (CV_32F, continuous)
+ * @param world			homogeneous world coordinates
+ * @return cv::Point	pixel position
+ */
+static inline cv::Point projectVoxel(const cv::Mat& projection, const cv::Vec4f& world) {
+	const float* P = projection.ptr<float>();
+	float u = P[0] * world[0] + P[1] * world[1] + P[2] * world[2] + P[3] * world[3];
+	float v = P[4] * world[0] + P[5] * world[1] + P[6] * world[2] + P[7] * world[3];
+	float w = P[8] * world[0] + P[9] * world[1] + P[10] * world[2] + P[11] * world[3];
+	return cv::Point(roundToPixel(u / w), roundToPixel(v / w));
+}
+
+/**
+ * @brief This function projects the n points start + k * step (k = first..first+n-1) of a row into a view.
+ * Projection is affine in the homogeneous coordinates, so numerator and denominator are stepped along the row
+ * and only one division per coordinate remains. Uses AVX2/SSE2 when available.
+ * Every kernel computes point k from the homogeneous coordinates of start and step in the same order, so a point gets the same pixel
+ * whichever part of the row it is projected with (and with projectRowPoint).
+ *
+ * @param projection	3x4 projection matrix (CV_32F, continuous)
+ * @param start			homogeneous world coordinates of point 0 of the row
+ * @param step			world coordinate increment between two neighbouring points
+ * @param n				number of points
+ * @param px			output x pixel coordinates (n elements, px[k - first] for point k)
+ * @param py			output y pixel coordinates (n elements, py[k - first] for point k)
+ * @param first			first point of the row that is projected
+ */
+void projectRow(const cv::Mat& projection, const cv::Vec4f& start, const cv::Vec4f& step, int n, int* px, int* py, int first = 0);
+
+/**
+ * @brief Portable version of projectRow, which computes the remainder of the packed rows and is the reference of the packed kernels.
+ */
+void projectRowScalar(const cv::Mat& projection, const cv::Vec4f& start, const cv::Vec4f& step, int n, int* px, int* py, int first = 0);
+
+/**
+ * @brief This function projects point k of a row into a view, the pixel is the same projectRow gives it.
+ *
+ * @param projection	3x4 projection matrix (CV_32F, continuous)
+ * @param start			homogeneous world coordinates of point 0 of the row
+ * @param step			world coordinate increment between two neighbouring points
+ * @param k				point of the row
+ * @return cv::Point	pixel position
+ */
+static inline cv::Point projectRowPoint(const cv::Mat& projection, const cv::Vec4f& start, const cv::Vec4f& step, int k) {
+	cv::Point pixel;
+	projectRowScalar(projection, start, step, 1, &pixel.x, &pixel.y, k);
+	return pixel;
+}
+
+/**
+ * @brief Camera intrinsics and lens distortion (OpenCV model with the coefficients k1, k2, p1, p2, k3, k4, k5, k6).
+ */
+struct LensModel {
+	float fx, fy, cx, cy;
+	float k1, k2, p1, p2, k3, k4, k5, k6;
+	float maxRadius2; // squared radius (normalized coordinates) beyond which points lie far outside of the image, where the polynomial is not valid anymore
+};
+
+/**
+ * @brief This function applies the lens distortion to normalized camera coordinates and converts them to pixels.
+ *
+ * @param lens			intrinsics and distortion coefficients
+ * @param x				normalized x coordinate (X / Z)
+ * @param y				normalized y coordinate (Y / Z)
+ * @return cv::Point	pixel position, points beyond lens.maxRadius2 are mapped to INT_MIN (outside of every image)
+ */
+static inline cv::Point distortToPixel(const LensModel& lens, float x, float y) {
+	float r2 = x * x + y * y;
+	if (!(r2 <= lens.maxRadius2)) {
+		return cv::Point(INT_MIN, INT_MIN);
+	}
+	float radial = (1 + r2 * (lens.k1 + r2 * (lens.k2 + r2 * lens.k3))) / (1 + r2 * (lens.k4 + r2 * (lens.k5 + r2 * lens.k6)));
+	// same order of operations as the packed projectRow, so both give the same pixels
+	float xy = x * y;
+	float xd = x * radial + 2 * lens.p1 * xy + lens.p2 * (r2 + 2 * (x * x));
+	float yd = y * radial + lens.p1 * (r2 + 2 * (y * y)) + 2 * lens.p2 * xy;
+	return cv::Point(roundToPixel(lens.fx * xd + lens.cx), roundToPixel(lens.fy * yd + lens.cy));
+}
+
+/**
+ * @brief This function projects a single point into the original (distorted) image of a view.
+ *
+ * @param pose			3x4 world to camera transformation (CV_32F, continuous)
+ * @param lens			intrinsics and distortion coefficients
+ * @param world			homogeneous world coordinates
+ * @return cv::Point	pixel position
+ */
+static inline cv::Point projectVoxel(const cv::Mat& pose, const LensModel& lens, const cv::Vec4f& world) {
+	const float* T = pose.ptr<float>();
+	float X = T[0] * world[0] + T[1] * world[1] + T[2] * world[2] + T[3] * world[3];
+	float Y = T[4] * world[0] + T[5] * world[1] + T[6] * world[2] + T[7] * world[3];
+	float Z = T[8] * world[0] + T[9] * world[1] + T[10] * world[2] + T[11] * world[3];
+	return distortToPixel(lens, X / Z, Y / Z);
+}
+
+/**
+ * @brief This function projects the n points start + k * step (k = first..first+n-1) of a row into the original (distorted) image of a view.
+ * Camera coordinates are stepped along the row, the distortion polynomial is evaluated with AVX2/SSE2 when available.
+ *
+ * @param pose			3x4 world to camera transformation (CV_32F, continuous)
+ * @param lens			intrinsics and distortion coefficients
+ * @param start			homogeneous world coordinates of point 0 of the row
+ * @param step			world coordinate increment between two neighbouring points
+ * @param n				number of points
+ * @param px			output x pixel coordinates (n elements, px[k - first] for point k)
+ * @param py			output y pixel coordinates (n elements, py[k - first] for point k)
+ * @param first			first point of the row that is projected
+ */
+void projectRow(const cv::Mat& pose, const LensModel& lens, const cv::Vec4f& start, const cv::Vec4f& step, int n, int* px, int* py, int first = 0);
+
+/**
+ * @brief Portable version of the distorted projectRow, which computes the remainder of the packed rows and is the reference of the packed kernels.
+ */
+void projectRowScalar(const cv::Mat& pose, const LensModel& lens, const cv::Vec4f& start, const cv::Vec4f& step, int n, int* px, int* py, int first = 0);
+
+/**
+ * @brief This function projects point k of a row into the original (distorted) image of a view, the pixel is the same projectRow gives it.
+ */
+static inline cv::Point projectRowPoint(const cv::Mat& pose, const LensModel& lens, const cv::Vec4f& start, const cv::Vec4f& step, int k) {
+	cv::Point pixel;
+	projectRowScalar(pose, lens, start, step, 1, &pixel.x, &pixel.y, k);
+	return pixel;
+}
+
+/**
+ * @brief Name of the kernel projectRow uses (AVX2, SSE2 or portable).
+ */
+const char* projectionKernel();
+
+#endif
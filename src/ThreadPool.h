@@ -0,0 +1,217 @@
+#pragma once
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+private:
+	ThreadPool() {}
+
+	~ThreadPool() {
+		StopWorkers();
+	}
+
+	std::vector<std::thread> workers;
+	std::queue<std::function<void()>> tasks;
+	std::vector<std::function<void()>> pinned; // task of each worker, only that worker runs it (ParallelForStatic)
+	std::mutex mutex;
+	std::condition_variable taskAvailable;
+	std::condition_variable taskDone;
+	int pending = 0;
+	bool stopping = false;
+
+	void WorkerLoop(int index) {
+		while (true) {
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				taskAvailable.wait(lock, [this, index] { return stopping || !tasks.empty() || pinned[index]; });
+				if (pinned[index]) {
+					task = std::move(pinned[index]);
+					pinned[index] = nullptr;
+				}
+				else if (tasks.empty()) {
+					return;
+				}
+				else {
+					task = std::move(tasks.front());
+					tasks.pop();
+				}
+			}
+			task();
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				pending--;
+			}
+			taskDone.notify_all();
+		}
+	}
+
+	void StopWorkers() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		taskAvailable.notify_all();
+		for (std::thread& worker : workers) {
+			worker.join();
+		}
+		workers.clear();
+		stopping = false;
+	}
+
+public:
+	ThreadPool(ThreadPool const&) = delete;
+
+	void operator=(ThreadPool const&) = delete;
+
+	/**
+	* @brief Method to access singleton instance (with lazy initialization)
+	*
+	* @return ThreadPool	the singleton instance
+	*/
+	static ThreadPool& GetInstance() {
+		static ThreadPool instance;
+
+		return instance;
+	}
+
+	/**
+	* @brief Method to set the number of threads used by parallel loops
+	*
+	* @param threads	number of threads, 0 uses all hardware threads
+	*/
+	void SetThreadCount(int threads) {
+		if (threads <= 0) {
+			threads = std::max(1, (int)std::thread::hardware_concurrency());
+		}
+		StopWorkers();
+		pinned.assign(threads - 1, nullptr);
+		// the calling thread always takes part in the work, so one thread needs no workers
+		for (int i = 1; i < threads; i++) {
+			workers.emplace_back(&ThreadPool::WorkerLoop, this, i - 1);
+		}
+	}
+
+	/**
+	* @brief Method to get the number of threads used by parallel loops
+	*
+	* @return int	number of threads (including the calling thread)
+	*/
+	int GetThreadCount() {
+		return (int)workers.size() + 1;
+	}
+
+	/**
+	* @brief Method to split the range [begin, end) into chunks and process them in parallel.
+	* Returns once every chunk has been processed. With a single thread the body is called once for the whole range.
+	* Chunks must not call ParallelFor themselves.
+	*
+	* @param begin	first index of the range
+	* @param end	index behind the last element of the range
+	* @param body	function processing the sub range [chunkBegin, chunkEnd)
+	*/
+	void ParallelFor(int begin, int end, const std::function<void(int, int)>& body) {
+		if (end <= begin) {
+			return;
+		}
+		int threads = GetThreadCount();
+		if (threads == 1 || end - begin == 1) {
+			body(begin, end);
+			return;
+		}
+
+		// a few chunks per thread balance uneven work between the chunks
+		int chunks = std::min(end - begin, threads * 4);
+		int chunkSize = (end - begin + chunks - 1) / chunks;
+		std::vector<std::pair<int, int>> ranges;
+		for (int i = begin; i < end; i += chunkSize) {
+			ranges.push_back({ i, std::min(end, i + chunkSize) });
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			// the first chunk is processed by the calling thread
+			for (int i = 1; i < ranges.size(); i++) {
+				std::pair<int, int> range = ranges[i];
+				tasks.push([&body, range] { body(range.first, range.second); });
+				pending++;
+			}
+		}
+		taskAvailable.notify_all();
+
+		body(ranges[0].first, ranges[0].second);
+
+		// help with the remaining chunks instead of idling
+		while (true) {
+			std::function<void()> task;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				if (tasks.empty()) {
+					taskDone.wait(lock, [this] { return pending == 0; });
+					return;
+				}
+				task = std::move(tasks.front());
+				tasks.pop();
+			}
+			task();
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				pending--;
+			}
+			taskDone.notify_all();
+		}
+	}
+
+	/**
+	* @brief Method to split the range [begin, end) into one chunk per thread and process them in parallel, chunk i always by the same thread
+	* (the calling thread takes the first chunk, worker i - 1 chunk i). Loops over the same range touch the same elements from the same thread,
+	* so memory first touched by one of them (and placed on the NUMA node of that thread) is processed by that thread in the others.
+	* Unlike ParallelFor, uneven work between the chunks is not balanced. Chunks must not call ParallelFor themselves.
+	*
+	* @param begin	first index of the range
+	* @param end	index behind the last element of the range
+	* @param body	function processing the sub range [chunkBegin, chunkEnd)
+	*/
+	void ParallelForStatic(int begin, int end, const std::function<void(int, int)>& body) {
+		if (end <= begin) {
+			return;
+		}
+		int threads = GetThreadCount();
+		if (threads == 1 || end - begin == 1) {
+			body(begin, end);
+			return;
+		}
+
+		auto chunk = [&](int i) { return begin + (int)((long long)(end - begin) * i / threads); };
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (int i = 1; i < threads; i++) {
+				std::pair<int, int> range = { chunk(i), chunk(i + 1) };
+				if (range.first < range.second) {
+					pinned[i - 1] = [&body, range] { body(range.first, range.second); };
+					pending++;
+				}
+			}
+		}
+		taskAvailable.notify_all();
+
+		if (chunk(0) < chunk(1)) {
+			body(chunk(0), chunk(1));
+		}
+
+		// the other chunks belong to their workers
+		std::unique_lock<std::mutex> lock(mutex);
+		taskDone.wait(lock, [this] { return pending == 0; });
+	}
+};
+
+#endif
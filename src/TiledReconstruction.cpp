@@ -0,0 +1,161 @@
+#include <iostream>
+#include <unordered_map>
+#include "TiledReconstruction.h"
+#include "MappedFile.h"
+#include "Postprocessing3d.h"
+
+// bytes of a voxel in the backing file (RGBA8)
+#define TILE_VOXEL_BYTES 4
+// vertices closer than 1 / TILE_WELD_PRECISION voxels are merged
+#define TILE_WELD_PRECISION 1024
+
+/**
+ * @brief Layout of the backing file: the voxels are stored tile by tile (each tile as a full tile^3 block), so every tile is a contiguous range.
+ */
+struct TileGrid {
+	cv::Vec3i dims;		// number of voxels of the grid
+	cv::Vec3i tiles;	// number of tiles
+	int tile;			// edge length of the tiles in voxels
+
+	TileGrid(cv::Vec3i dims, int tile) : dims(dims),
+		tiles((dims(0) + tile - 1) / tile, (dims(1) + tile - 1) / tile, (dims(2) + tile - 1) / tile), tile(tile) {}
+
+	size_t count() { return (size_t)tiles(0) * tiles(1) * tiles(2); }
+	size_t tileVoxels() { return (size_t)tile * tile * tile; }
+
+	size_t index(int x, int y, int z) {
+		size_t t = x / tile + tiles(0) * (y / tile + (size_t)tiles(1) * (z / tile));
+		return t * tileVoxels() + x % tile + tile * (y % tile + (size_t)tile * (z % tile));
+	}
+};
+
+struct VertexKey {
+	int64_t x, y, z;
+	bool operator==(const VertexKey& other) const { return x == other.x && y == other.y && z == other.z; }
+};
+
+struct VertexKeyHash {
+	size_t operator()(const VertexKey& key) const {
+		return std::hash<int64_t>()(key.x) ^ std::hash<int64_t>()(key.y) * 0x9E3779B97F4A7C15ull ^ std::hash<int64_t>()(key.z) * 0xC2B2AE3D27D4EB4Full;
+	}
+};
+
+static cv::Vec3i clampToGrid(cv::Vec3i v, cv::Vec3i dims) {
+	return cv::Vec3i(std::min(std::max(v(0), 0), dims(0)), std::min(std::max(v(1), 0), dims(1)), std::min(std::max(v(2), 0), dims(2)));
+}
+
+/**
+ * @brief Largest tile edge length whose tiles (with halo) fit into the budget, 0 if not even a single voxel does.
+ */
+static int chooseTileSize(cv::Vec3i dims, ModelStorage storage, VoxelLayout layout, size_t memoryBudget, int halo, int models) {
+	for (int tile = std::max(dims(0), std::max(dims(1), dims(2))); tile > 0; tile--) {
+		cv::Vec3i extent = clampToGrid(cv::Vec3i(tile + 2 * halo, tile + 2 * halo, tile + 2 * halo), dims);
+		if (models * Model::memorySize(extent(0), extent(1), extent(2), storage, layout) <= memoryBudget) {
+			return tile;
+		}
+	}
+	return 0;
+}
+
+bool reconstructTiled(int x, int y, int z, float size, ModelStorage storage, VoxelLayout layout, size_t memoryBudget, const std::string& backingFile,
+	const std::function<void(Model&)>& reconstruct, int kernelSize, float scale, Vector3f translation, const std::string& outFileName) {
+	cv::Vec3i dims(x, y, z);
+	// the closure of a voxel reads the voxels up to twice its radius away, the last cells of a tile read one voxel behind it
+	int halo = kernelSize > 1 ? 2 * (kernelSize / 2) + 1 : 1;
+	int tileSize = chooseTileSize(dims, storage, layout, memoryBudget, halo, kernelSize > 1 ? 2 : 1);
+	if (tileSize == 0) {
+		std::cerr << "LOG(ERR) - TR: the memory budget is too small for a single tile. Aborting reconstruction!" << std::endl;
+		return false;
+	}
+	TileGrid grid(dims, tileSize);
+	MappedFile file(backingFile, grid.count() * grid.tileVoxels() * TILE_VOXEL_BYTES);
+	if (!file.isOpen()) {
+		std::cerr << "LOG(ERR) - TR: could not create backing file " << backingFile << ". Aborting reconstruction!" << std::endl;
+		return false;
+	}
+	std::cout << "LOG - TR: reconstructing " << grid.count() << " tiles of " << tileSize << "^3 voxels (halo " << halo << "), backing file "
+		<< file.size() / (1024 * 1024) << " MB." << std::endl;
+
+	// carve and color the tiles, every voxel is written once
+	int index = 0;
+	for (int tz = 0; tz < grid.tiles(2); tz++) {
+		for (int ty = 0; ty < grid.tiles(1); ty++) {
+			for (int tx = 0; tx < grid.tiles(0); tx++, index++) {
+				cv::Vec3i min(tx * tileSize, ty * tileSize, tz * tileSize);
+				cv::Vec3i max = clampToGrid(min + cv::Vec3i(tileSize, tileSize, tileSize), dims);
+				cv::Vec3i low = clampToGrid(min - cv::Vec3i(1, 1, 1), dims), high = clampToGrid(max + cv::Vec3i(1, 1, 1), dims);
+				std::cout << "LOG - TR: carving tile " << index + 1 << " of " << grid.count() << "." << std::endl;
+
+				Model tile(high(0) - low(0), high(1) - low(1), high(2) - low(2), size, storage, low, layout);
+				reconstruct(tile);
+				tile.handleUnseen();
+				for (int k = min(2); k < max(2); k++) {
+					for (int j = min(1); j < max(1); j++) {
+						for (int i = min(0); i < max(0); i++) {
+							packVoxel(tile.get(i - low(0), j - low(1), k - low(2)), file.data() + grid.index(i, j, k) * TILE_VOXEL_BYTES);
+						}
+					}
+				}
+				// the tile is complete, its pages can go to the file
+				file.release(index * grid.tileVoxels() * TILE_VOXEL_BYTES, grid.tileVoxels() * TILE_VOXEL_BYTES);
+			}
+		}
+	}
+
+	// close and mesh the tiles, vertices on the seams are shared with the tiles before
+	SimpleMesh mesh;
+	std::unordered_map<VertexKey, unsigned int, VertexKeyHash> vertexIds;
+	index = 0;
+	for (int tz = 0; tz < grid.tiles(2); tz++) {
+		for (int ty = 0; ty < grid.tiles(1); ty++) {
+			for (int tx = 0; tx < grid.tiles(0); tx++, index++) {
+				cv::Vec3i min(tx * tileSize, ty * tileSize, tz * tileSize);
+				cv::Vec3i max = clampToGrid(min + cv::Vec3i(tileSize, tileSize, tileSize), dims);
+				cv::Vec3i low = clampToGrid(min - cv::Vec3i(halo, halo, halo), dims), high = clampToGrid(max + cv::Vec3i(halo, halo, halo), dims);
+				std::cout << "LOG - TR: meshing tile " << index + 1 << " of " << grid.count() << "." << std::endl;
+
+				Model tile(high(0) - low(0), high(1) - low(1), high(2) - low(2), size, storage, low, layout);
+				for (int k = low(2); k < high(2); k++) {
+					for (int j = low(1); j < high(1); j++) {
+						for (int i = low(0); i < high(0); i++) {
+							tile.set(i - low(0), j - low(1), k - low(2), unpackVoxel(file.data() + grid.index(i, j, k) * TILE_VOXEL_BYTES));
+						}
+					}
+				}
+				if (kernelSize > 1) {
+					applyClosure(&tile, kernelSize);
+				}
+
+				// cells in front of the grid belong to the first tiles
+				SimpleMesh tileMesh;
+				cv::Vec3i begin(min(0) == 0 ? -1 : min(0), min(1) == 0 ? -1 : min(1), min(2) == 0 ? -1 : min(2));
+				marchCells(&tile, begin - low, max - low, &tileMesh);
+
+				HugePageVector<Vector3f>& vertices = tileMesh.GetVertices();
+				Vector3f tileOrigin((float)low(0), (float)low(1), (float)low(2));
+				for (Triangle& triangle : tileMesh.GetTriangles()) {
+					unsigned int ids[3];
+					unsigned int corners[3] = { triangle.idx0, triangle.idx1, triangle.idx2 };
+					for (int c = 0; c < 3; c++) {
+						Vector3f vertex = vertices[corners[c]] + tileOrigin;
+						VertexKey key = { std::llround(vertex.x() * TILE_WELD_PRECISION), std::llround(vertex.y() * TILE_WELD_PRECISION), std::llround(vertex.z() * TILE_WELD_PRECISION) };
+						auto it = vertexIds.find(key);
+						if (it == vertexIds.end()) {
+							it = vertexIds.emplace(key, mesh.AddVertex(vertex)).first;
+						}
+						ids[c] = it->second;
+					}
+					mesh.AddFace(ids[0], ids[1], ids[2], triangle.r, triangle.g, triangle.b);
+				}
+			}
+		}
+	}
+
+	std::cout << "LOG - TR: " << mesh.GetVertices().size() << " vertices and " << mesh.GetTriangles().size() << " triangles.\n Writing mesh..." << std::endl;
+	if (!mesh.WriteMesh(outFileName, scale * size, translation)) {
+		std::cerr << "LOG(ERR) - TR: unable to write output file!" << std::endl;
+		return false;
+	}
+	std::cout << "LOG - TR: Mesh written, tiled reconstruction completed." << std::endl;
+	return true;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#ifndef TILED_RECONSTRUCTION_H
+#define TILED_RECONSTRUCTION_H
+
+#include <functional>
+#include <string>
+#include "Model.h"
+#include "MarchingCubes.h"
+
+/**
+ * @brief This function reconstructs a grid of x * y * z voxels tile by tile, so only a tile has to fit into memory instead of the whole grid.
+ * The first pass carves and colors every tile with a halo of one voxel (for the surface test of the coloring) and streams its voxels
+ * to a memory-mapped backing file. The second pass loads every tile with a halo of 2 * (kernelSize / 2) + 1 voxels from that file,
+ * which is what the closure and the cells at the end of the tile read, closes it and converts the cells of the tile into triangles.
+ * Cells belong to the tile of their first corner and vertices are merged across tiles, so the mesh is the same as reconstructing
+ * the whole grid at once, without seams and without duplicate vertices.
+ *
+ * @param x				number of voxels of the grid in x direction
+ * @param y				number of voxels of the grid in y direction
+ * @param z				number of voxels of the grid in z direction
+ * @param size			side length of a voxel
+ * @param storage		memory layout of the tiles (dense or compact)
+ * @param layout		order of the voxels of the tiles
+ * @param memoryBudget	bytes the voxels of the tiles may take at a time, determines the tile size
+ * @param backingFile	path of the backing file, it holds 4 bytes per voxel (RGBA8) of the carved and colored grid afterwards
+ * @param reconstruct	carves and colors a tile, which is a model placed at its position in the grid (offset)
+ * @param kernelSize	kernel size of the closure, 1 to skip it
+ * @param scale			scaling factor to be applied on the result mesh
+ * @param translation	translation vector to be applied on the resulting mesh
+ * @param outFileName	name of the output file the mesh will be written to
+ * @return bool			whether the mesh was written successfully
+ */
+bool reconstructTiled(int x, int y, int z, float size, ModelStorage storage, VoxelLayout layout, size_t memoryBudget, const std::string& backingFile,
+	const std::function<void(Model&)>& reconstruct, int kernelSize, float scale, Vector3f translation, const std::string& outFileName);
+
+#endif
@@ -0,0 +1,108 @@
+#include <iostream>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/calib3d.hpp>
+#include "aruco_samples_utility.hpp"
+#include "PoseEstimation.h"
+#include "ViewSet.h"
+
+/**
+ * @brief Builds the lens model of an image, returns false if the distortion coefficients are not supported (thin prism and tilt).
+ */
+static bool createLensModel(cv::Mat& cameraMatrix, cv::Mat& distCoeffs, cv::Size image_size, LensModel& lens) {
+	cv::Mat K, D;
+	cameraMatrix.convertTo(K, CV_64F);
+	distCoeffs.convertTo(D, CV_64F);
+	double coeffs[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+	for (int i = 0; i < (int)D.total(); i++) {
+		if (i >= 8 && D.at<double>(i) != 0) {
+			return false;
+		}
+		if (i < 8) {
+			coeffs[i] = D.at<double>(i);
+		}
+	}
+	lens.fx = (float)K.at<double>(0, 0);
+	lens.fy = (float)K.at<double>(1, 1);
+	lens.cx = (float)K.at<double>(0, 2);
+	lens.cy = (float)K.at<double>(1, 2);
+	lens.k1 = (float)coeffs[0];
+	lens.k2 = (float)coeffs[1];
+	lens.p1 = (float)coeffs[2];
+	lens.p2 = (float)coeffs[3];
+	lens.k3 = (float)coeffs[4];
+	lens.k4 = (float)coeffs[5];
+	lens.k5 = (float)coeffs[6];
+	lens.k6 = (float)coeffs[7];
+
+	// the image corners are the points with the largest radius, points clearly beyond them can't be seen
+	std::vector<cv::Point2f> corners = { cv::Point2f(0, 0), cv::Point2f((float)image_size.width, 0),
+		cv::Point2f(0, (float)image_size.height), cv::Point2f((float)image_size.width, (float)image_size.height) };
+	std::vector<cv::Point2f> normalized;
+	cv::undistortPoints(corners, normalized, cameraMatrix, distCoeffs);
+	float max_radius2 = 0;
+	for (cv::Point2f& corner : normalized) {
+		max_radius2 = std::max(max_radius2, corner.x * corner.x + corner.y * corner.y);
+	}
+	lens.maxRadius2 = 1.44f * max_radius2;
+	return true;
+}
+
+ViewSet::ViewSet(cv::Mat& cameraMatrix, cv::Mat& distCoeffs, bool distortedProjection) : cameraMatrix(cameraMatrix), distCoeffs(distCoeffs), distortedProjection(distortedProjection) {}
+
+ViewSet::ViewSet(cv::Mat& cameraMatrix, cv::Mat& distCoeffs, std::vector<cv::Mat>& images, std::vector<cv::Mat>& masks, bool distortedProjection) : ViewSet(cameraMatrix, distCoeffs, distortedProjection) {
+	std::cout << "LOG - VS: estimating poses and " << (distortedProjection ? "preparing distorted projections." : "removing distortions.") << std::endl;
+	for (int i = 0; i < images.size(); i++) {
+		addView(images[i], masks[i]);
+	}
+	std::cout << "LOG - VS: prepared " << views.size() << " views." << std::endl;
+}
+
+void ViewSet::addView(cv::Mat& image, cv::Mat& mask) {
+	// camera to world transformation, the pose is its inverse
+	cv::Mat cameraToWorld = estimatePoseFromImage(cameraMatrix, distCoeffs, image, false);
+	addView(cameraToWorld.inv()(cv::Rect(0, 0, 4, 3)), image.size());
+	setFrames(size() - 1, image, mask);
+}
+
+void ViewSet::addView(const cv::Mat& pose, cv::Size size) {
+	// Format camera intrinsics
+	cv::Mat intr = cameraMatrix.clone();
+	intr.convertTo(intr, CV_32F);
+
+	CameraView view;
+	pose.convertTo(view.pose, CV_32F);
+	view.pose = view.pose.clone();
+	view.projection = intr * view.pose;
+	// the camera centre is -R^T t, the same for estimated poses and poses read from snapshots
+	cv::Mat pose64;
+	view.pose.convertTo(pose64, CV_64F);
+	cv::Mat center = -pose64(cv::Rect(0, 0, 3, 3)).t() * pose64(cv::Rect(3, 0, 1, 3));
+	view.center = cv::Vec4f((float)center.at<double>(0), (float)center.at<double>(1), (float)center.at<double>(2), 1);
+
+	view.distorted = distortedProjection && createLensModel(cameraMatrix, distCoeffs, size, view.lens);
+	if (distortedProjection && !view.distorted) {
+		std::cerr << "LOG - VS: distortion model not supported for distorted projections, undistorting image " << views.size() << " instead." << std::endl;
+	}
+	view.borders = cv::Rect(0, 0, size.width, size.height);
+	views.push_back(view);
+}
+
+void ViewSet::setFrames(int i, cv::Mat& image, cv::Mat& mask) {
+	CameraView& view = views[i];
+	if (view.distorted) {
+		view.image = image;
+		view.mask = mask;
+	}
+	else {
+		cv::undistort(image, view.image, cameraMatrix, distCoeffs);
+		if (!mask.empty()) {
+			cv::undistort(mask, view.mask, cameraMatrix, distCoeffs);
+		}
+	}
+	if (!view.mask.empty()) {
+		cv::Mat background;
+		cv::inRange(view.mask, cv::Scalar(0, 0, 0), cv::Scalar(0, 0, 0), background);
+		background.convertTo(background, CV_8U, 1.0 / 255);
+		cv::integral(background, view.backgroundSum, CV_32S);
+	}
+}
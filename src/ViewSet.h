@@ -0,0 +1,134 @@
+#pragma once
+
+#ifndef VIEW_SET_H
+#define VIEW_SET_H
+
+#include <vector>
+#include <opencv2/core/mat.hpp>
+#include "Projection.h"
+
+/**
+ * @brief Camera data of a single input frame.
+ * Pose estimation and undistortion are done once when the view is created and shared by all stages afterwards.
+ * Alternatively images and masks are kept as they are and the lens distortion is applied to every projected voxel.
+ */
+struct CameraView {
+	cv::Mat pose;			// 3x4 world to camera transformation (CV_32F)
+	cv::Mat projection;		// 3x4 projection matrix, intrinsics * pose (CV_32F)
+	bool distorted;			// whether image and mask are the original frames, projections have to apply the lens distortion
+	LensModel lens;			// intrinsics and distortion coefficients, used if distorted
+	cv::Vec4f center;		// homogeneous camera centre in world coordinates
+	cv::Mat image;			// color image (undistorted unless distorted is set)
+	cv::Mat mask;			// segmentation mask (undistorted unless distorted is set), empty for views that only color
+	cv::Mat backgroundSum;	// summed-area table of the background pixels of the mask ((rows + 1) x (cols + 1), CV_32S)
+	cv::Rect borders;		// image area used for bounds checks
+
+	/**
+	 * @brief Number of background pixels (all channels 0) of the mask within the rectangle.
+	 *
+	 * @param rect	rectangle, has to lie within the image borders
+	 * @return int	number of background pixels
+	 */
+	int countBackground(const cv::Rect& rect) {
+		return backgroundSum.at<int>(rect.y + rect.height, rect.x + rect.width) - backgroundSum.at<int>(rect.y, rect.x + rect.width)
+			- backgroundSum.at<int>(rect.y + rect.height, rect.x) + backgroundSum.at<int>(rect.y, rect.x);
+	}
+
+	/**
+	 * @brief Pixel position of a point in image and mask of this view.
+	 * Voxels of a grid are projected as points of their x-row with projectRow or projectRowPoint instead, which can round points on the
+	 * edge between two pixels differently.
+	 *
+	 * @param world			homogeneous world coordinates
+	 * @return cv::Point	pixel position
+	 */
+	cv::Point project(const cv::Vec4f& world) {
+		return distorted ? projectVoxel(pose, lens, world) : projectVoxel(projection, world);
+	}
+
+	/**
+	 * @brief Pixel positions of the n points start + k * step (k = first..first+n-1) of a row in image and mask of this view.
+	 * Voxel x of a grid is projected as point Model::rowPoint(x) of the row starting at Model::rowStart(y, z), so every stage gets the same pixel for it.
+	 */
+	void projectRow(const cv::Vec4f& start, const cv::Vec4f& step, int n, int* px, int* py, int first = 0) {
+		if (distorted) {
+			::projectRow(pose, lens, start, step, n, px, py, first);
+		}
+		else {
+			::projectRow(projection, start, step, n, px, py, first);
+		}
+	}
+
+	/**
+	 * @brief Pixel position of point k of the row starting at start in image and mask of this view, the same projectRow gives it.
+	 */
+	cv::Point projectRowPoint(const cv::Vec4f& start, const cv::Vec4f& step, int k) {
+		return distorted ? ::projectRowPoint(pose, lens, start, step, k) : ::projectRowPoint(projection, start, step, k);
+	}
+};
+
+class ViewSet
+{
+private:
+	cv::Mat cameraMatrix;
+	cv::Mat distCoeffs;
+	bool distortedProjection;
+	std::vector<CameraView> views;
+
+public:
+	/**
+	 * @brief Creates an empty set of views, views are added with addView.
+	 *
+	 * @param cameraMatrix			camera intrinsics
+	 * @param distCoeffs			distortion coefficients
+	 * @param distortedProjection	keep images and masks as they are and apply the distortion to the projected voxels instead
+	 */
+	ViewSet(cv::Mat& cameraMatrix, cv::Mat& distCoeffs, bool distortedProjection = false);
+
+	/**
+	 * @brief Estimates the pose of every frame and removes the lens distortion from images and masks.
+	 *
+	 * @param cameraMatrix			camera intrinsics
+	 * @param distCoeffs			distortion coefficients
+	 * @param images				colored images
+	 * @param masks					segmentation masks
+	 * @param distortedProjection	keep images and masks as they are and apply the distortion to the projected voxels instead
+	 */
+	ViewSet(cv::Mat& cameraMatrix, cv::Mat& distCoeffs, std::vector<cv::Mat>& images, std::vector<cv::Mat>& masks, bool distortedProjection = false);
+
+	/**
+	 * @brief Estimates the pose of a frame and adds it as a view.
+	 *
+	 * @param image		colored image
+	 * @param mask		segmentation mask, empty if the view only colors voxels
+	 */
+	void addView(cv::Mat& image, cv::Mat& mask);
+
+	/**
+	 * @brief Adds a view whose pose is known (e.g. from a snapshot) without image and mask, so it can project voxels before its frames are loaded.
+	 * Image and mask are attached with setFrames before the view is carved or colored with.
+	 *
+	 * @param pose		3x4 world to camera transformation
+	 * @param size		image size
+	 */
+	void addView(const cv::Mat& pose, cv::Size size);
+
+	/**
+	 * @brief Attaches image and mask to a view and removes their distortion unless the view applies it to the projections.
+	 *
+	 * @param i			index of the view
+	 * @param image		colored image
+	 * @param mask		segmentation mask, empty if the view only colors voxels
+	 */
+	void setFrames(int i, cv::Mat& image, cv::Mat& mask);
+
+	int size() { return (int)views.size(); }
+	CameraView& operator[](int i) { return views[i]; }
+	std::vector<CameraView>::iterator begin() { return views.begin(); }
+	std::vector<CameraView>::iterator end() { return views.end(); }
+
+	cv::Mat& getCameraMatrix() { return cameraMatrix; }
+	cv::Mat& getDistCoeffs() { return distCoeffs; }
+};
+
+#endif
@@ -1,167 +1,1329 @@
 #pragma once
-#include <queue>
-#include "aruco_samples_utility.hpp"
-#include "PoseEstimation.h"
+#include <atomic>
+#include <cfloat>
+#include <climits>
+#include <mutex>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/calib3d.hpp>
 #include "VoxelCarving.h"
+#include "AtomicBitset.h"
+#include "Projection.h"
 #include "Segmentation.h"
 #include "MarchingCubes.h"
 #include "Benchmark.h"
+#include "ThreadPool.h"
 
 /**
- * @brief This function performs a projection from world to camera coordinates.
+ * @brief This function carves the voxels of the box [min, max) using a single frame.
+ * Voxels are independent of each other, so disjoint boxes (slabs or bricks) can be carved concurrently.
  *
- * @param world         homogeneous world coordinates
- * @param pose          pose transformation
- * @param intr          camera intrinsics
- * @return cv::Vec3f    homogeneous camera coordinates
+ * @param view          camera view to carve
+ * @param index         index of the view, used for the carve record of the model
+ * @param model         voxel model
+ * @param min           first voxel of the box
+ * @param max           voxel behind the last voxel of the box
  */
-static cv::Vec3f worldToCamera(cv::Vec4f world, cv::Mat& pose, cv::Mat& intr) {
-    cv::Mat1f proj = intr * pose * world;
-    return cv::Vec3f(proj(0) / proj(2), proj(1) / proj(2), 1);
+template <class Grid>
+static void carveBox(CameraView& view, int index, Grid& model, cv::Vec3i min, cv::Vec3i max) {
+    // project whole x-rows at once, counted from the start of the row so every box gets the same pixels for a voxel
+    int n = max(0) - min(0);
+    std::vector<int> px(n), py(n);
+    cv::Vec4f x_step = model.rowStep();
+    for (int z = min(2); z < max(2); z++) {
+        for (int y = min(1); y < max(1); y++) {
+            view.projectRow(model.rowStart(y, z), x_step, n, px.data(), py.data(), model.rowPoint(min(0)));
+            for (int x = min(0); x < max(0); x++) {
+                // check if corresponding pixel is part of the object or background
+                cv::Point pixel_pos = cv::Point(px[x - min(0)], py[x - min(0)]);
+                if (!pixel_pos.inside(view.borders))
+                {
+                    continue;
+                }
+                cv::Vec3b pixel = view.mask.at<cv::Vec3b>(pixel_pos);
+                if (pixel(0) == 0 && pixel(1) == 0 && pixel(2) == 0) // masked pixel -> set alpha = 0
+                {
+                    model.set(x, y, z, Eigen::Vector4f(0, 0, 0, 0));
+                    if (model.hasCarveRecord()) {
+                        model.recordCarve(x, y, z, index);
+                    }
+                }
+                model.see(x, y, z);
+            }
+        }
+    }
 }
 
-static void carve(cv::Mat& cameraMatrix, cv::Mat& distCoeffs, Model& model, cv::Mat& image, cv::Mat& mask) {
-    // Estimate camera extrinsics
-    cv::Mat pose = estimatePoseFromImage(cameraMatrix, distCoeffs, image, false);
-    pose = pose.inv();
+/**
+ * @brief This function carves the voxels of the box [min, max) using a single frame, looking at the whole footprint of every voxel.
+ * With maxForeground > 0 a voxel is carved if the share of foreground pixels within the bounding rectangle of its projected corners is below it,
+ * otherwise the pixel under the centre decides as in the standard carving. The share is also stored as coverage if the model keeps it.
+ *
+ * @param view          camera view to carve
+ * @param index         index of the view, used for the carve record of the model
+ * @param model         voxel model
+ * @param min           first voxel of the box
+ * @param max           voxel behind the last voxel of the box
+ * @param maxForeground foreground fraction below which a voxel is carved, 0 to test the centre pixel
+ */
+template <class Grid>
+static void carveBoxFootprint(CameraView& view, int index, Grid& model, cv::Vec3i min, cv::Vec3i max, float maxForeground) {
+    // the corners of the voxels of an x-row lie on 4 rows of n points, which are projected at once (the 5th row holds the centres)
+    int n = max(0) - min(0) + 1;
+    std::vector<int> px(5 * n), py(5 * n);
+    cv::Vec4f x_step = model.rowStep();
+    cv::Vec4f y_half = (model.toWord(0, 1, 0) - model.toWord(0, 0, 0)) * 0.5;
+    cv::Vec4f z_half = (model.toWord(0, 0, 1) - model.toWord(0, 0, 0)) * 0.5;
+    for (int z = min(2); z < max(2); z++) {
+        for (int y = min(1); y < max(1); y++) {
+            cv::Vec4f first = model.rowStart(y, z) - x_step * 0.5 - y_half - z_half;
+            for (int r = 0; r < 4; r++) {
+                cv::Vec4f start = first + (r & 1 ? y_half * 2 : cv::Vec4f()) + (r & 2 ? z_half * 2 : cv::Vec4f());
+                view.projectRow(start, x_step, n, &px[r * n], &py[r * n], model.rowPoint(min(0)));
+            }
+            if (maxForeground == 0) {
+                view.projectRow(model.rowStart(y, z), x_step, n - 1, &px[4 * n], &py[4 * n], model.rowPoint(min(0)));
+            }
+            for (int x = min(0); x < max(0); x++) {
+                int left = INT_MAX, right = INT_MIN, top = INT_MAX, bottom = INT_MIN;
+                for (int r = 0; r < 4; r++) {
+                    for (int i = r * n + x - min(0); i <= r * n + x - min(0) + 1; i++) {
+                        left = std::min(left, px[i]);
+                        right = std::max(right, px[i]);
+                        top = std::min(top, py[i]);
+                        bottom = std::max(bottom, py[i]);
+                    }
+                }
+                if (left == INT_MIN || top == INT_MIN) { // corner without a valid projection (both kernels map it to INT_MIN)
+                    continue;
+                }
 
-    // Format camera intrinsics
-    cv::Mat intr = cameraMatrix.clone();
-    intr.convertTo(intr, CV_32F);
+                // pixels covered by the footprint within the image
+                left = std::max(left, view.borders.x);
+                right = std::min(right, view.borders.br().x - 1);
+                top = std::max(top, view.borders.y);
+                bottom = std::min(bottom, view.borders.br().y - 1);
+                if (left > right || top > bottom)
+                {
+                    continue;
+                }
+                cv::Rect footprint(left, top, right - left + 1, bottom - top + 1);
+                int foreground = footprint.area() - view.countBackground(footprint);
+                if (model.hasCoverage()) {
+                    model.updateCoverage(x, y, z, (float)foreground / footprint.area());
+                }
 
-    cv::Rect image_borders = cv::Rect(0, 0, image.cols, image.rows);
+                bool carved;
+                if (maxForeground > 0) {
+                    carved = foreground < maxForeground * footprint.area();
+                }
+                else {
+                    cv::Point pixel_pos = cv::Point(px[4 * n + x - min(0)], py[4 * n + x - min(0)]);
+                    if (!pixel_pos.inside(view.borders))
+                    {
+                        continue;
+                    }
+                    cv::Vec3b pixel = view.mask.at<cv::Vec3b>(pixel_pos);
+                    carved = pixel(0) == 0 && pixel(1) == 0 && pixel(2) == 0;
+                }
+                if (carved) // masked pixel(s) -> set alpha = 0
+                {
+                    model.set(x, y, z, Eigen::Vector4f(0, 0, 0, 0));
+                    if (model.hasCarveRecord()) {
+                        model.recordCarve(x, y, z, index);
+                    }
+                }
+                model.see(x, y, z);
+            }
+        }
+    }
+}
 
-    // remove distorions
-    cv::Mat undist_mask;
-    cv::undistort(mask, undist_mask, cameraMatrix, distCoeffs);
+template <class Grid>
+static void carveVoxels(CameraView& view, int index, Grid& model, cv::Vec3i min, cv::Vec3i max, float footprint) {
+    if (footprint > 0 || model.hasCoverage()) {
+        carveBoxFootprint(view, index, model, min, max, footprint);
+    }
+    else {
+        carveBox(view, index, model, min, max);
+    }
+}
 
-    int x, y, z;
-    for_each_voxel(x, y, z) {
-        // check if corresponding pixel is part of the object or background
-        cv::Mat subm = pose(cv::Rect(0, 0, 4, 3));
-        cv::Vec4f word_coord = model.toWord(x, y, z);
-        cv::Vec3f camera_coord = worldToCamera(word_coord, subm, intr);
-        cv::Point pixel_pos = cv::Point((int)std::round(camera_coord[0]), (int)std::round(camera_coord[1]));
-        if (!pixel_pos.inside(image_borders))
-        {
-            continue;
+static void carve(CameraView& view, int index, Model& model, const std::vector<cv::Vec3i>& bricks, float footprint) {
+    // storage and layout of the model are resolved once per view, the voxel loops are instantiated for each of them
+    dispatchVoxelAccess(model, [&](auto& grid) {
+        if (model.getStorage() == ModelStorage::Sparse) {
+            // bricks are disjoint, only the allocated ones can hold voxels
+            ThreadPool::GetInstance().ParallelFor(0, (int)bricks.size(), [&](int begin, int end) {
+                for (int i = begin; i < end; i++) {
+                    carveVoxels(view, index, grid, bricks[i], grid.brickEnd(bricks[i]), footprint);
+                }
+            });
         }
-        cv::Vec3b pixel = undist_mask.at<cv::Vec3b>(pixel_pos);
-        if (pixel(0) == 0 && pixel(1) == 0 && pixel(2) == 0) // masked pixel -> set alpha = 0
-        {
-            model.set(x, y, z, Eigen::Vector4f(0, 0, 0, 0));
+        else {
+            // split the volume into z-slabs, which are contiguous in memory, each on the thread that first touched it (Model::fillParallel)
+            ThreadPool::GetInstance().ParallelForStatic(0, model.getZ(), [&](int z_begin, int z_end) {
+                carveVoxels(view, index, grid, cv::Vec3i(0, 0, z_begin), cv::Vec3i(model.getX(), model.getY(), z_end), footprint);
+            });
         }
-        model.see(x, y, z);
-    }
+    });
 
     std::cout << "LOG - VC: completed carving of a single image." << std::endl;
 }
 
-void carve(cv::Mat& cameraMatrix, cv::Mat& distCoeffs, Model& model, std::vector<cv::Mat>& images, std::vector<cv::Mat>& masks, bool intermediateMeshes) {
-    std::cout << "LOG - VC: starting carving process (version 1)." << std::endl;
+static void allocateBricks(ViewSet& views, Model& model);
+
+void carve(ViewSet& views, Model& model, bool intermediateMeshes, float footprint) {
+    std::cout << "LOG - VC: starting carving process (version 1, " << ThreadPool::GetInstance().GetThreadCount() << " threads)." << std::endl;
     Benchmark::GetInstance().LogCarving(true);
-    for (int i = 0; i < images.size(); i++) { // carve each frame separately
-        carve(cameraMatrix, distCoeffs, model, images[i], masks[i]);
+    if (model.hasImplicitBricks()) {
+        allocateBricks(views, model);
+    }
+    std::vector<cv::Vec3i> bricks = model.getBricks();
+    for (int i = 0; i < views.size(); i++) { // carve each frame separately
+        carve(views[i], i, model, bricks, footprint);
         if (intermediateMeshes) {
             std::cout << "LOG - VC: generating intermediate mesh for image " << i << std::endl;
             marchingCubes(&model, 1.0f, Vector3f(i*(model.getX() + 2)*model.getSize(), 0, 0), 0.5f, (std::string) ("out/intermediate/image_" +  std::to_string(i) + "_mesh.off"));
         }
     }
+    if (model.getStorage() == ModelStorage::Sparse) {
+        std::cout << "LOG - VC: " << model.releaseEmptyBricks() << " of " << bricks.size() << " bricks left." << std::endl;
+    }
     Benchmark::GetInstance().LogCarving(false);
     std::cout << "LOG - VC: carving complete." << std::endl;
 }
 
-void fastCarve(cv::Mat& cameraMatrix, cv::Mat& distCoeffs, Model& model, std::vector<cv::Mat>& images, std::vector<cv::Mat>& masks) {
-    std::cout << "LOG - VC: starting carving process (version 2)." << std::endl;
+std::vector<cv::Vec3i> carveIncremental(ViewSet& views, Model& model, const std::vector<int>& newViews) {
+    std::cout << "LOG - VC: starting incremental carving (" << newViews.size() << " new views, " << ThreadPool::GetInstance().GetThreadCount() << " threads)." << std::endl;
     Benchmark::GetInstance().LogCarving(true);
-    // Estimate pose for each image and remove distortion from images/masks
-    std::vector<cv::Mat> poses;
-    std::vector<cv::Mat> undist_imgs;
-    std::vector<cv::Mat> undist_masks;
-    for (int i = 0; i < images.size(); i++)
-    {
-        poses.push_back(estimatePoseFromImage(cameraMatrix, distCoeffs, images[i], false).inv()(cv::Rect(0, 0, 4, 3)));
+    if (model.hasImplicitBricks()) {
+        allocateBricks(views, model);
+    }
+    std::vector<cv::Vec3i> bricks = model.getBricks();
+
+    // occupancy before carving, a voxel is exposed if it was inner then and is on the surface now
+    size_t n = (size_t)model.getX() * model.getY() * model.getZ();
+    AtomicBitset before(n);
+    auto flatten = [&](int x, int y, int z) { return x + (size_t)model.getX() * (y + (size_t)model.getY() * z); };
+    ThreadPool::GetInstance().ParallelFor(0, (int)bricks.size(), [&](int begin, int end) {
+        for (int b = begin; b < end; b++) {
+            cv::Vec3i max = model.brickEnd(bricks[b]);
+            for (int z = bricks[b](2); z < max(2); z++) {
+                for (int y = bricks[b](1); y < max(1); y++) {
+                    for (int x = bricks[b](0); x < max(0); x++) {
+                        if (model.isOccupied(x, y, z)) {
+                            before.set(flatten(x, y, z));
+                        }
+                    }
+                }
+            }
+        }
+    });
+    auto occupiedBefore = [&](int x, int y, int z) {
+        return x >= 0 && x < model.getX() && y >= 0 && y < model.getY() && z >= 0 && z < model.getZ() && before.test(flatten(x, y, z));
+    };
 
-        cv::Mat undist_img;
-        cv::undistort(images[i], undist_img, cameraMatrix, distCoeffs);
-        undist_imgs.push_back(undist_img);
-        cv::Mat undist_mask;
-        cv::undistort(masks[i], undist_mask, cameraMatrix, distCoeffs);
-        undist_masks.push_back(undist_mask);
+    for (int v : newViews) {
+        carve(views[v], v, model, bricks, 0);
     }
 
-    // Format camera intrinsics
-    cv::Mat intr = cameraMatrix.clone();
-    intr.convertTo(intr, CV_32F);
+    // surface voxels that are exposed now or that a new view sees, both change their colors
+    cv::Vec4f x_step = model.rowStep();
+    std::vector<cv::Vec3i> recolor;
+    std::atomic<int> exposed(0);
+    std::mutex recolor_mutex;
+    ThreadPool::GetInstance().ParallelFor(0, (int)bricks.size(), [&](int begin, int end) {
+        std::vector<cv::Vec3i> chunk_recolor;
+        int chunk_exposed = 0;
+        for (int b = begin; b < end; b++) {
+            cv::Vec3i max = model.brickEnd(bricks[b]);
+            for (int z = bricks[b](2); z < max(2); z++) {
+                for (int y = bricks[b](1); y < max(1); y++) {
+                    for (int x = bricks[b](0); x < max(0); x++) {
+                        if (!model.isOccupied(x, y, z) || model.isInner(x, y, z)) {
+                            continue;
+                        }
+                        bool isExposed = occupiedBefore(x - 1, y, z) && occupiedBefore(x + 1, y, z)
+                            && occupiedBefore(x, y - 1, z) && occupiedBefore(x, y + 1, z)
+                            && occupiedBefore(x, y, z - 1) && occupiedBefore(x, y, z + 1);
+                        bool seen = false;
+                        for (int i = 0; i < (int)newViews.size() && !isExposed && !seen; i++) {
+                            seen = views[newViews[i]].projectRowPoint(model.rowStart(y, z), x_step, model.rowPoint(x)).inside(views[newViews[i]].borders);
+                        }
+                        if (isExposed || seen) {
+                            chunk_recolor.push_back(cv::Vec3i(x, y, z));
+                            chunk_exposed += isExposed;
+                        }
+                    }
+                }
+            }
+        }
+        exposed += chunk_exposed;
+        std::lock_guard<std::mutex> lock(recolor_mutex);
+        recolor.insert(recolor.end(), chunk_recolor.begin(), chunk_recolor.end());
+    });
 
-    cv::Rect image_borders = cv::Rect(0, 0, images[0].cols, images[0].rows);
+    if (model.getStorage() == ModelStorage::Sparse) {
+        std::cout << "LOG - VC: " << model.releaseEmptyBricks() << " of " << bricks.size() << " bricks left." << std::endl;
+    }
+    Benchmark::GetInstance().LogCarving(false);
+    std::cout << "LOG - VC: incremental carving complete, " << exposed << " voxels exposed, " << recolor.size() - exposed << " surface voxels seen by the new views." << std::endl;
+    return recolor;
+}
 
-    // Greedy carve voxels
-    std::queue<cv::Vec3i> q;
-    q.push(cv::Vec3i(0, 0, 0));
+// only every n-th voxel along each axis is used to estimate the carving order
+#define SURVIVOR_ORDER_SAMPLING 4
 
-    while (!q.empty())
-    {
-        cv::Vec3i current = q.front();
-        q.pop();
-        if (model.visited(current)) {
-            continue;
+/**
+ * @brief This function orders the views greedily by the number of (sampled) voxels they remove from what is left by the views before.
+ *
+ * @param views                 camera views
+ * @param model                 voxel model
+ * @return std::vector<int>     indices of the views in carving order
+ */
+static std::vector<int> orderViewsByRemoval(ViewSet& views, Model& model) {
+    std::vector<cv::Vec3i> samples;
+    for (int z = 0; z < model.getZ(); z += SURVIVOR_ORDER_SAMPLING) {
+        for (int y = 0; y < model.getY(); y += SURVIVOR_ORDER_SAMPLING) {
+            for (int x = 0; x < model.getX(); x += SURVIVOR_ORDER_SAMPLING) {
+                if (model.isOccupied(x, y, z)) {
+                    samples.push_back(cv::Vec3i(x, y, z));
+                }
+            }
         }
-        model.visit(current);
+    }
 
-        bool carved = false;
-        for (int i = 0; i < images.size(); i++) // for each image check if voxel can be carved
-        {
+    std::vector<int> order;
+    std::vector<bool> used(views.size(), false);
+    for (int k = 0; k < views.size(); k++) {
+        // background flags of the samples for the best view so far
+        int best = -1;
+        std::vector<char> best_carved, carved(samples.size());
+        size_t best_removed = 0;
+        for (int i = 0; i < views.size(); i++) {
+            if (used[i]) {
+                continue;
+            }
+            size_t removed = 0;
+            for (size_t j = 0; j < samples.size(); j++) {
+                carved[j] = 0;
+                cv::Point pixel_pos = views[i].projectRowPoint(model.rowStart(samples[j](1), samples[j](2)), model.rowStep(), model.rowPoint(samples[j](0)));
+                if (pixel_pos.inside(views[i].borders))
+                {
+                    cv::Vec3b pixel = views[i].mask.at<cv::Vec3b>(pixel_pos);
+                    carved[j] = pixel(0) == 0 && pixel(1) == 0 && pixel(2) == 0;
+                }
+                removed += carved[j];
+            }
+            if (best == -1 || removed > best_removed) {
+                best = i;
+                best_removed = removed;
+                best_carved.swap(carved);
+                carved.resize(samples.size());
+            }
+        }
+        used[best] = true;
+        order.push_back(best);
+
+        size_t n = 0;
+        for (size_t j = 0; j < samples.size(); j++) {
+            if (!best_carved[j]) {
+                samples[n++] = samples[j];
+            }
+        }
+        samples.resize(n);
+    }
+    return order;
+}
+
+// consecutive surviving voxels [x_begin, x_end) of the x-row y (of a z-slice)
+struct VoxelRun {
+    int x_begin;
+    int x_end;
+    int y;
+};
+
+/**
+ * @brief This function carves the surviving voxels of a z-slice using a single frame and keeps the runs that are left.
+ *
+ * @param view          camera view to carve
+ * @param model         voxel model
+ * @param z             z-slice
+ * @param runs          surviving voxels of the slice, replaced by the voxels that survive this view
+ * @param px            buffer for the x pixel coordinates of a row
+ * @param py            buffer for the y pixel coordinates of a row
+ */
+static void carveRuns(CameraView& view, Model& model, int z, std::vector<VoxelRun>& runs, std::vector<int>& px, std::vector<int>& py) {
+    std::vector<VoxelRun> left;
+    cv::Vec4f x_step = model.rowStep();
+    for (VoxelRun& run : runs) {
+        // the part of the row is projected as in the standard carving, which projects the whole row
+        view.projectRow(model.rowStart(run.y, z), x_step, run.x_end - run.x_begin, px.data(), py.data(), model.rowPoint(run.x_begin));
+        int start = -1; // first voxel of the current surviving run
+        for (int x = run.x_begin; x < run.x_end; x++) {
+            // check if corresponding pixel is part of the object or background
+            cv::Point pixel_pos = cv::Point(px[x - run.x_begin], py[x - run.x_begin]);
+            bool carved = false;
+            if (pixel_pos.inside(view.borders))
+            {
+                cv::Vec3b pixel = view.mask.at<cv::Vec3b>(pixel_pos);
+                if (pixel(0) == 0 && pixel(1) == 0 && pixel(2) == 0) // masked pixel -> set alpha = 0
+                {
+                    model.set(x, run.y, z, Eigen::Vector4f(0, 0, 0, 0));
+                    carved = true;
+                }
+                model.see(x, run.y, z);
+            }
+            if (!carved && start < 0) {
+                start = x;
+            }
+            else if (carved && start >= 0) {
+                left.push_back({ start, x, run.y });
+                start = -1;
+            }
+        }
+        if (start >= 0) {
+            left.push_back({ start, run.x_end, run.y });
+        }
+    }
+    runs.swap(left);
+}
+
+void survivorCarve(ViewSet& views, Model& model, bool orderViews) {
+    std::cout << "LOG - VC: starting carving process (version 4, " << ThreadPool::GetInstance().GetThreadCount() << " threads)." << std::endl;
+    Benchmark::GetInstance().LogCarving(true);
+
+    std::vector<int> order;
+    if (orderViews) {
+        order = orderViewsByRemoval(views, model);
+    }
+    else {
+        for (int i = 0; i < views.size(); i++) {
+            order.push_back(i);
+        }
+    }
+
+    // surviving voxels as x-runs per z-slice, initially every row is one run
+    std::vector<std::vector<VoxelRun>> slices(model.getZ());
+    for (std::vector<VoxelRun>& slice : slices) {
+        for (int y = 0; y < model.getY(); y++) {
+            slice.push_back({ 0, model.getX(), y });
+        }
+    }
+
+    // every view only tests the voxels left by the views before, carved voxels have been marked seen by the view that carved them
+    for (int i : order) {
+        ThreadPool::GetInstance().ParallelFor(0, model.getZ(), [&](int z_begin, int z_end) {
+            std::vector<int> px(model.getX()), py(model.getX());
+            for (int z = z_begin; z < z_end; z++) {
+                carveRuns(views[i], model, z, slices[z], px, py);
+            }
+        });
+
+        size_t left = 0;
+        for (std::vector<VoxelRun>& slice : slices) {
+            for (VoxelRun& run : slice) {
+                left += run.x_end - run.x_begin;
+            }
+        }
+        std::cout << "LOG - VC: completed carving of a single image (" << left << " voxels left)." << std::endl;
+    }
+
+    Benchmark::GetInstance().LogCarving(false);
+    std::cout << "LOG - VC: carving complete." << std::endl;
+}
+
+// voxels [z_begin, z_end) of a column
+struct ZInterval {
+    int z_begin;
+    int z_end;
+};
+
+/**
+ * @brief This function appends the voxels [z_begin, z_end) to the intervals of a column, merging it with the last interval if they touch.
+ */
+static void keepInterval(std::vector<ZInterval>& intervals, int z_begin, int z_end) {
+    if (!intervals.empty() && intervals.back().z_end == z_begin) {
+        intervals.back().z_end = z_end;
+        return;
+    }
+    intervals.push_back({ z_begin, z_end });
+}
+
+// z-ranges with at most this many voxels are tested voxel by voxel instead of being split further
+#define COLUMN_MIN_SEGMENT 4
+
+/**
+ * @brief This function carves the voxels [z_begin, z_end) of the column (x, y) using a single frame.
+ * The voxel centres of a column lie on a line, so their projections move monotonically along a line segment of the image
+ * and the pixels of all voxels in between lie within the rectangle spanned by the pixels of the first and the last voxel,
+ * padded by a pixel against the rounding of the voxels (every voxel is projected as a point of its x-row like in the standard carving).
+ * A range is decided at once if that rectangle is background or foreground only, otherwise it is split in halves.
+ *
+ * @param view          camera view to carve
+ * @param model         voxel model
+ * @param x, y          column
+ * @param z_begin       first voxel of the range
+ * @param z_end         voxel behind the last voxel of the range
+ * @param left          voxels that survive this view are appended here
+ */
+static void carveSegment(CameraView& view, Model& model, int x, int y, int z_begin, int z_end, std::vector<ZInterval>& left) {
+    cv::Vec4f x_step = model.rowStep();
+    if (z_end - z_begin <= COLUMN_MIN_SEGMENT) {
+        for (int z = z_begin; z < z_end; z++) {
             // check if corresponding pixel is part of the object or background
-            cv::Vec4f word_coord = model.toWord(current);
-            cv::Vec3f camera_coord = worldToCamera(word_coord, poses[i], intr);
-            cv::Point pixel_pos = cv::Point((int)std::round(camera_coord[0]), (int)std::round(camera_coord[1]));
-            if (!pixel_pos.inside(image_borders))
+            cv::Point pixel_pos = view.projectRowPoint(model.rowStart(y, z), x_step, model.rowPoint(x));
+            if (!pixel_pos.inside(view.borders))
             {
+                keepInterval(left, z, z + 1);
                 continue;
             }
-            cv::Vec3b pixel = undist_masks[i].at<cv::Vec3b>(pixel_pos);
+            cv::Vec3b pixel = view.mask.at<cv::Vec3b>(pixel_pos);
             if (pixel(0) == 0 && pixel(1) == 0 && pixel(2) == 0) // masked pixel -> set alpha = 0
             {
-                model.set(current, Eigen::Vector4f(0, 0, 0, 0));
-                carved = true;
-                break;
+                model.set(x, y, z, Eigen::Vector4f(0, 0, 0, 0));
             }
+            else {
+                keepInterval(left, z, z + 1);
+            }
+            model.see(x, y, z);
         }
+        return;
+    }
 
-        if (carved) // if voxel was carved add newly revealed voxels to the queue
-        {
-            // x neighbours
-            if (current(0) > 0 && !model.visited(cv::Vec3i(current(0) - 1, current(1), current(2)))) // x > 0
-            {
-                q.push(cv::Vec3i(current(0) - 1, current(1), current(2)));
+    cv::Point first = view.projectRowPoint(model.rowStart(y, z_begin), x_step, model.rowPoint(x));
+    cv::Point last = view.projectRowPoint(model.rowStart(y, z_end - 1), x_step, model.rowPoint(x));
+    int left_x = std::min(first.x, last.x), right_x = std::max(first.x, last.x);
+    int top_y = std::min(first.y, last.y), bottom_y = std::max(first.y, last.y);
+    bool valid = left_x != INT_MIN && top_y != INT_MIN;
+    if (valid) {
+        left_x--, right_x++, top_y--, bottom_y++;
+    }
+    if (valid && (right_x < view.borders.x || left_x >= view.borders.br().x || bottom_y < view.borders.y || top_y >= view.borders.br().y)) {
+        keepInterval(left, z_begin, z_end); // the whole range projects outside of the image
+        return;
+    }
+    cv::Rect segment(left_x, top_y, right_x - left_x + 1, bottom_y - top_y + 1);
+    if (valid && (segment & view.borders) == segment) {
+        int background = view.countBackground(segment);
+        if (background == 0 || background == segment.area()) {
+            if (background == 0) {
+                keepInterval(left, z_begin, z_end);
             }
-            if (current(0) < model.getX() - 1 && !model.visited(cv::Vec3i(current(0) + 1, current(1), current(2)))) // x < X - 1
-            {
-                q.push(cv::Vec3i(current(0) + 1, current(1), current(2)));
+            for (int z = z_begin; z < z_end; z++) {
+                if (background != 0) // masked pixels -> set alpha = 0
+                {
+                    model.set(x, y, z, Eigen::Vector4f(0, 0, 0, 0));
+                }
+                model.see(x, y, z);
             }
+            return;
+        }
+    }
 
-            // y neighbours
-            if (current(1) > 0 && !model.visited(cv::Vec3i(current(0), current(1) - 1, current(2)))) // y > 0
-            {
-                q.push(cv::Vec3i(current(0), current(1) - 1, current(2)));
+    int z_mid = (z_begin + z_end) / 2;
+    carveSegment(view, model, x, y, z_begin, z_mid, left);
+    carveSegment(view, model, x, y, z_mid, z_end, left);
+}
+
+/**
+ * @brief This function carves the surviving voxels of the column (x, y) using a single frame.
+ *
+ * @param view          camera view to carve
+ * @param model         voxel model
+ * @param x, y          column
+ * @param interval      surviving voxels of the column to test
+ * @param left          voxels that survive this view are appended here
+ */
+static void carveInterval(CameraView& view, Model& model, int x, int y, ZInterval interval, std::vector<ZInterval>& left) {
+    const float* P = view.projection.ptr<float>();
+    cv::Vec4f first = model.toWord(x, y, interval.z_begin);
+    cv::Vec4f last = model.toWord(x, y, interval.z_end - 1);
+    float w_first = P[8] * first[0] + P[9] * first[1] + P[10] * first[2] + P[11] * first[3];
+    float w_last = P[8] * last[0] + P[9] * last[1] + P[10] * last[2] + P[11] * last[3];
+    // distorted projections bend the segment and columns reaching behind the camera aren't monotonic, these are tested voxel by voxel
+    if (view.distorted || !(w_first > 0 && w_last > 0)) {
+        for (int z = interval.z_begin; z < interval.z_end; z += COLUMN_MIN_SEGMENT) {
+            carveSegment(view, model, x, y, z, std::min(interval.z_end, z + COLUMN_MIN_SEGMENT), left);
+        }
+        return;
+    }
+    carveSegment(view, model, x, y, interval.z_begin, interval.z_end, left);
+}
+
+void columnCarve(ViewSet& views, Model& model) {
+    std::cout << "LOG - VC: starting carving process (version 5, " << ThreadPool::GetInstance().GetThreadCount() << " threads)." << std::endl;
+    Benchmark::GetInstance().LogCarving(true);
+
+    // every column is carved by all views at once, its surviving voxels are kept as z-intervals that shrink with every view
+    ThreadPool::GetInstance().ParallelFor(0, model.getY(), [&](int y_begin, int y_end) {
+        std::vector<ZInterval> intervals, left;
+        for (int y = y_begin; y < y_end; y++) {
+            for (int x = 0; x < model.getX(); x++) {
+                intervals.assign(1, { 0, model.getZ() });
+                for (CameraView& view : views) {
+                    left.clear();
+                    for (ZInterval& interval : intervals) {
+                        carveInterval(view, model, x, y, interval, left);
+                    }
+                    intervals.swap(left);
+                    if (intervals.empty()) { // the whole column is carved
+                        break;
+                    }
+                }
             }
-            if (current(1) < model.getY() - 1 && !model.visited(cv::Vec3i(current(0), current(1) + 1, current(2)))) // y < Y - 1
-            {
-                q.push(cv::Vec3i(current(0), current(1) + 1, current(2)));
+        }
+    });
+
+    Benchmark::GetInstance().LogCarving(false);
+    std::cout << "LOG - VC: carving complete." << std::endl;
+}
+
+// labels of the masks resampled into a slice, outside of the image the label is 0
+#define SLICE_FOREGROUND 1
+#define SLICE_BACKGROUND 2
+
+/**
+ * @brief This function resamples the mask labels of a view into the z-slice of the grid (nearest neighbour, rows y and columns x).
+ *
+ * @param view          camera view
+ * @param labels        SLICE_FOREGROUND/SLICE_BACKGROUND per mask pixel (CV_8U)
+ * @param model         voxel model
+ * @param z             z-slice
+ * @param slice         output labels of the slice voxels (model.getY() x model.getX(), CV_8U)
+ */
+static void warpSlice(CameraView& view, const cv::Mat& labels, Model& model, int z, cv::Mat& slice) {
+    if (view.distorted) { // there is no homography, project the rows voxel by voxel instead
+        slice.create(model.getY(), model.getX(), CV_8U);
+        std::vector<int> px(model.getX()), py(model.getX());
+        cv::Vec4f x_step = model.rowStep();
+        for (int y = 0; y < model.getY(); y++) {
+            view.projectRow(model.rowStart(y, z), x_step, model.getX(), px.data(), py.data(), model.rowPoint(0));
+            uchar* row = slice.ptr<uchar>(y);
+            for (int x = 0; x < model.getX(); x++) {
+                cv::Point pixel_pos = cv::Point(px[x], py[x]);
+                row[x] = pixel_pos.inside(view.borders) ? labels.at<uchar>(pixel_pos) : 0;
             }
+        }
+        return;
+    }
 
-            // y neighbours
-            if (current(2) > 0 && !model.visited(cv::Vec3i(current(0), current(1), current(2) - 1))) // z > 0
-            {
-                q.push(cv::Vec3i(current(0), current(1), current(2) - 1));
+    // toWord is affine in (x, y) within a slice, so the projection of a slice is a homography in (x, y)
+    cv::Mat P;
+    view.projection.convertTo(P, CV_64F);
+    cv::Vec4f origin = model.toWord(0, 0, z);
+    cv::Vec4f x_step = model.toWord(1, 0, z) - origin;
+    cv::Vec4f y_step = model.toWord(0, 1, z) - origin;
+    cv::Mat H(3, 3, CV_64F);
+    for (int r = 0; r < 3; r++) {
+        H.at<double>(r, 0) = H.at<double>(r, 1) = H.at<double>(r, 2) = 0;
+        for (int c = 0; c < 4; c++) {
+            H.at<double>(r, 0) += P.at<double>(r, c) * x_step[c];
+            H.at<double>(r, 1) += P.at<double>(r, c) * y_step[c];
+            H.at<double>(r, 2) += P.at<double>(r, c) * origin[c];
+        }
+    }
+    cv::warpPerspective(labels, slice, H, cv::Size(model.getX(), model.getY()), cv::INTER_NEAREST | cv::WARP_INVERSE_MAP, cv::BORDER_CONSTANT, cv::Scalar(0));
+}
+
+void sliceCarve(ViewSet& views, Model& model) {
+    std::cout << "LOG - VC: starting carving process (version 6, " << ThreadPool::GetInstance().GetThreadCount() << " threads)." << std::endl;
+    Benchmark::GetInstance().LogCarving(true);
+
+    // background pixels -> SLICE_BACKGROUND, foreground pixels -> SLICE_FOREGROUND
+    std::vector<cv::Mat> labels(views.size());
+    for (int i = 0; i < views.size(); i++) {
+        cv::Mat background;
+        cv::inRange(views[i].mask, cv::Scalar(0, 0, 0), cv::Scalar(0, 0, 0), background);
+        background.convertTo(labels[i], CV_8U, 1.0 / 255, SLICE_FOREGROUND);
+    }
+
+    ThreadPool::GetInstance().ParallelFor(0, model.getZ(), [&](int z_begin, int z_end) {
+        cv::Mat slice, combined;
+        for (int z = z_begin; z < z_end; z++) {
+            // or-ing the labels of all views: a voxel is kept if no view has the background bit, and seen if any view has a label
+            combined = cv::Mat::zeros(model.getY(), model.getX(), CV_8U);
+            for (int i = 0; i < views.size(); i++) {
+                warpSlice(views[i], labels[i], model, z, slice);
+                cv::bitwise_or(combined, slice, combined);
             }
-            if (current(2) < model.getZ() - 1 && !model.visited(cv::Vec3i(current(0), current(1), current(2) + 1))) // z < Z - 1
-            {
-                q.push(cv::Vec3i(current(0), current(1), current(2) + 1));
+
+            for (int y = 0; y < model.getY(); y++) {
+                const uchar* row = combined.ptr<uchar>(y);
+                for (int x = 0; x < model.getX(); x++) {
+                    if (row[x] & SLICE_BACKGROUND) // masked pixel -> set alpha = 0
+                    {
+                        model.set(x, y, z, Eigen::Vector4f(0, 0, 0, 0));
+                    }
+                    if (row[x]) {
+                        model.see(x, y, z);
+                    }
+                }
             }
         }
+    });
+
+    Benchmark::GetInstance().LogCarving(false);
+    std::cout << "LOG - VC: carving complete." << std::endl;
+}
+
+/**
+ * @brief This function marches a ray through the grid (3D DDA) and carves the crossed voxels whose centre projects onto background.
+ * Grid coordinates are chosen so that voxel (x, y, z) covers [x, x + 1) x [y, y + 1) x [z, z + 1).
+ *
+ * @param view          camera view the ray belongs to
+ * @param model         voxel model
+ * @param carved        voxels that have been carved so far (x + X * (y + Y * z))
+ * @param origin        start of the ray in grid coordinates
+ * @param direction     direction of the ray in grid coordinates
+ */
+static void carveRay(CameraView& view, Model& model, AtomicBitset& carved, cv::Vec3f origin, cv::Vec3f direction) {
+    int size[3] = { model.getX(), model.getY(), model.getZ() };
+
+    // part of the ray within the grid, only in front of the camera
+    float t_enter = 0, t_exit = FLT_MAX;
+    for (int i = 0; i < 3; i++) {
+        if (direction[i] == 0) {
+            if (origin[i] < 0 || origin[i] >= size[i]) {
+                return;
+            }
+            continue;
+        }
+        float t0 = -origin[i] / direction[i];
+        float t1 = (size[i] - origin[i]) / direction[i];
+        t_enter = std::max(t_enter, std::min(t0, t1));
+        t_exit = std::min(t_exit, std::max(t0, t1));
+    }
+    if (!(t_enter < t_exit)) {
+        return;
+    }
+
+    int voxel[3], step[3];
+    float t_max[3], t_delta[3];
+    for (int i = 0; i < 3; i++) {
+        voxel[i] = std::min(size[i] - 1, std::max(0, (int)std::floor(origin[i] + t_enter * direction[i])));
+        step[i] = direction[i] > 0 ? 1 : -1;
+        if (direction[i] == 0) {
+            t_max[i] = FLT_MAX;
+            t_delta[i] = FLT_MAX;
+            continue;
+        }
+        float boundary = (float)(direction[i] > 0 ? voxel[i] + 1 : voxel[i]);
+        t_max[i] = (boundary - origin[i]) / direction[i];
+        t_delta[i] = std::fabs(1 / direction[i]);
+    }
+
+    while (true) {
+        size_t i = voxel[0] + (size_t)size[0] * (voxel[1] + (size_t)size[1] * voxel[2]);
+        if (!carved.test(i)) {
+            // check if corresponding pixel is part of the object or background (same pixel as in the standard carving)
+            cv::Point pixel_pos = view.projectRowPoint(model.rowStart(voxel[1], voxel[2]), model.rowStep(), model.rowPoint(voxel[0]));
+            if (pixel_pos.inside(view.borders)) {
+                cv::Vec3b pixel = view.mask.at<cv::Vec3b>(pixel_pos);
+                if (pixel(0) == 0 && pixel(1) == 0 && pixel(2) == 0 && !carved.testAndSet(i)) // masked pixel -> set alpha = 0
+                {
+                    model.set(voxel[0], voxel[1], voxel[2], Eigen::Vector4f(0, 0, 0, 0));
+                }
+                model.see(voxel[0], voxel[1], voxel[2]);
+            }
+        }
+
+        // step into the neighbour whose boundary is crossed first
+        int axis = t_max[0] < t_max[1] ? (t_max[0] < t_max[2] ? 0 : 2) : (t_max[1] < t_max[2] ? 1 : 2);
+        if (t_max[axis] > t_exit) {
+            return;
+        }
+        voxel[axis] += step[axis];
+        if (voxel[axis] < 0 || voxel[axis] >= size[axis]) {
+            return;
+        }
+        t_max[axis] += t_delta[axis];
+    }
+}
+
+/**
+ * @brief This function finds the voxels [x_begin, x_end) of the x-row (y, z) whose centre projects into the image of the view.
+ * In front of the camera the projection of a row is monotonic, so these voxels form a single range. Its ends are solved from the
+ * linear bounds of the homogeneous image coordinates and then moved onto the first and last voxel that project inside as points of the row
+ * (CameraView::projectRowPoint, the pixels of the standard carving), so only a few voxels of the row are projected.
+ *
+ * @return bool     false if the range can't be solved this way (distorted view or row reaching the camera plane)
+ */
+static bool imageSpan(CameraView& view, Model& model, int y, int z, int& x_begin, int& x_end) {
+    int n = model.getX();
+    if (view.distorted) {
+        return false;
+    }
+    const float* P = view.projection.ptr<float>();
+    cv::Vec4f start = model.toWord(0, y, z);
+    cv::Vec4f step = model.toWord(1, 0, 0) - model.toWord(0, 0, 0);
+    double h[3], dh[3];
+    for (int r = 0; r < 3; r++) {
+        h[r] = (double)P[4 * r] * start[0] + (double)P[4 * r + 1] * start[1] + (double)P[4 * r + 2] * start[2] + (double)P[4 * r + 3] * start[3];
+        dh[r] = (double)P[4 * r] * step[0] + (double)P[4 * r + 1] * step[1] + (double)P[4 * r + 2] * step[2] + (double)P[4 * r + 3] * step[3];
+    }
+    if (!(h[2] > 0 && h[2] + (n - 1) * dh[2] > 0)) {
+        return false;
+    }
+
+    // pixel c rounds into [low, high] for c in [low - 0.5, high + 0.5), i.e. h + x * dh - (low - 0.5) * w >= 0 and (high + 0.5) * w - h - x * dh > 0
+    double lo = 0, hi = n - 1;
+    int low[2] = { view.borders.x, view.borders.y };
+    int high[2] = { view.borders.br().x - 1, view.borders.br().y - 1 };
+    for (int r = 0; r < 2; r++) {
+        double bounds[2][2] = {
+            { h[r] - (low[r] - 0.5) * h[2], dh[r] - (low[r] - 0.5) * dh[2] },
+            { (high[r] + 0.5) * h[2] - h[r], (high[r] + 0.5) * dh[2] - dh[r] } };
+        for (auto& bound : bounds) {
+            // bound[0] + x * bound[1] >= 0
+            if (bound[1] > 0) {
+                lo = std::max(lo, -bound[0] / bound[1]);
+            }
+            else if (bound[1] < 0) {
+                hi = std::min(hi, -bound[0] / bound[1]);
+            }
+            else if (bound[0] < 0) {
+                lo = DBL_MAX;
+            }
+        }
+    }
+
+    // the bounds are exact up to rounding, the ends are moved onto the voxels the carving projection puts inside
+    cv::Vec4f row_start = model.rowStart(y, z);
+    auto inside = [&](int x) { return view.projectRowPoint(row_start, model.rowStep(), model.rowPoint(x)).inside(view.borders); };
+    if (lo > hi + 1) {
+        x_begin = x_end = 0;
+        return true;
+    }
+    x_begin = (int)std::min(std::max(std::ceil(lo), 0.0), n - 1.0);
+    x_end = (int)std::min(std::max(std::floor(hi), 0.0), n - 1.0) + 1;
+    while (x_begin > 0 && inside(x_begin - 1)) {
+        x_begin--;
+    }
+    while (x_begin < x_end && !inside(x_begin)) {
+        x_begin++;
+    }
+    while (x_end < n && inside(x_end)) {
+        x_end++;
+    }
+    while (x_end > x_begin && !inside(x_end - 1)) {
+        x_end--;
+    }
+    x_end = std::max(x_end, x_begin);
+    return true;
+}
+
+void rayCarve(ViewSet& views, Model& model, int pixelStep) {
+    std::cout << "LOG - VC: starting carving process (version 7, " << ThreadPool::GetInstance().GetThreadCount() << " threads)." << std::endl;
+    Benchmark::GetInstance().LogCarving(true);
+
+    float s = model.getSize();
+    cv::Vec3i offset = model.getOffset();
+    AtomicBitset carved((size_t)model.getX() * model.getY() * model.getZ());
+    for (CameraView& view : views) {
+        // rays start at the pixel blocks that are background only, through their centre
+        std::vector<cv::Point2f> samples;
+        for (int v = 0; v + pixelStep <= view.borders.height; v += pixelStep) {
+            for (int u = 0; u + pixelStep <= view.borders.width; u += pixelStep) {
+                cv::Rect block(u, v, pixelStep, pixelStep);
+                if (view.countBackground(block) == block.area()) {
+                    samples.push_back(cv::Point2f(u + (pixelStep - 1) / 2.f, v + (pixelStep - 1) / 2.f));
+                }
+            }
+        }
+
+        // pixel -> direction: inverse of the left 3x3 block of the projection, or of the rotation for normalized (undistorted) coordinates
+        cv::Mat M;
+        if (view.distorted) {
+            std::vector<cv::Point2f> normalized;
+            cv::undistortPoints(samples, normalized, views.getCameraMatrix(), views.getDistCoeffs());
+            samples.swap(normalized);
+            view.pose(cv::Rect(0, 0, 3, 3)).convertTo(M, CV_64F);
+        }
+        else {
+            view.projection(cv::Rect(0, 0, 3, 3)).convertTo(M, CV_64F);
+        }
+        cv::Mat inverse = M.inv();
+        float A[9];
+        for (int i = 0; i < 9; i++) {
+            A[i] = (float)inverse.at<double>(i / 3, i % 3);
+        }
+
+        // toWord(x, y, z) = ((y + oy) * s, (x + ox) * s, -(z + oz) * s), shifted by half a voxel so voxels start at integer coordinates
+        cv::Vec3f origin(view.center[1] / s - offset(0) + 0.5f, view.center[0] / s - offset(1) + 0.5f, -view.center[2] / s - offset(2) + 0.5f);
+        ThreadPool::GetInstance().ParallelFor(0, (int)samples.size(), [&](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                cv::Point2f p = samples[i];
+                cv::Vec3f world(A[0] * p.x + A[1] * p.y + A[2], A[3] * p.x + A[4] * p.y + A[5], A[6] * p.x + A[7] * p.y + A[8]);
+                carveRay(view, model, carved, origin, cv::Vec3f(world[1] / s, world[0] / s, -world[2] / s));
+            }
+        });
+        std::cout << "LOG - VC: completed carving of a single image (" << samples.size() << " rays)." << std::endl;
+    }
+
+    // the rays marked the voxels they crossed as seen, the others are seen if their centre lies within any image.
+    // Instead of projecting them, the range of each row within each image is solved (imageSpan)
+    cv::Vec4f x_step = model.rowStep();
+    ThreadPool::GetInstance().ParallelFor(0, model.getZ(), [&](int z_begin, int z_end) {
+        std::vector<char> within(model.getX());
+        std::vector<int> px(model.getX()), py(model.getX());
+        for (int z = z_begin; z < z_end; z++) {
+            for (int y = 0; y < model.getY(); y++) {
+                std::fill(within.begin(), within.end(), 0);
+                for (CameraView& view : views) {
+                    int x_begin, x_end;
+                    if (imageSpan(view, model, y, z, x_begin, x_end)) {
+                        std::fill(within.begin() + x_begin, within.begin() + x_end, 1);
+                        continue;
+                    }
+                    // distorted views and rows reaching the camera plane are projected voxel by voxel
+                    view.projectRow(model.rowStart(y, z), x_step, model.getX(), px.data(), py.data(), model.rowPoint(0));
+                    for (int x = 0; x < model.getX(); x++) {
+                        within[x] |= cv::Point(px[x], py[x]).inside(view.borders);
+                    }
+                }
+                for (int x = 0; x < model.getX(); x++) {
+                    if (within[x] && !model.isSeen(x, y, z)) {
+                        model.see(x, y, z);
+                    }
+                }
+            }
+        }
+    });
+
+    Benchmark::GetInstance().LogCarving(false);
+    std::cout << "LOG - VC: carving complete." << std::endl;
+}
+
+/**
+ * @brief This function checks whether a voxel projects onto the background of any view.
+ */
+static bool isBackground(ViewSet& views, Model& model, cv::Vec3i voxel) {
+    cv::Vec4f row_start = model.rowStart(voxel(1), voxel(2));
+    for (CameraView& view : views) // for each image check if voxel can be carved
+    {
+        // check if corresponding pixel is part of the object or background
+        cv::Point pixel_pos = view.projectRowPoint(row_start, model.rowStep(), model.rowPoint(voxel(0)));
+        if (!pixel_pos.inside(view.borders))
+        {
+            continue;
+        }
+        cv::Vec3b pixel = view.mask.at<cv::Vec3b>(pixel_pos);
+        if (pixel(0) == 0 && pixel(1) == 0 && pixel(2) == 0) // masked pixel
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void fastCarve(ViewSet& views, Model& model) {
+    std::cout << "LOG - VC: starting carving process (version 2, " << ThreadPool::GetInstance().GetThreadCount() << " threads)." << std::endl;
+    Benchmark::GetInstance().LogCarving(true);
+
+    // Greedy carve voxels, one breadth-first level at a time.
+    // A voxel is claimed (visited) when it is added to a frontier, so every voxel is tested at most once
+    // and the carved region is the same as with a sequential search.
+    std::vector<cv::Vec3i> frontier;
+    std::vector<cv::Vec3i> next;
+    std::mutex next_mutex;
+    model.visit(cv::Vec3i(0, 0, 0));
+    frontier.push_back(cv::Vec3i(0, 0, 0));
+
+    while (!frontier.empty())
+    {
+        ThreadPool::GetInstance().ParallelFor(0, (int)frontier.size(), [&](int begin, int end) {
+            // every chunk collects its newly revealed voxels locally and appends them once
+            std::vector<cv::Vec3i> revealed;
+            for (int i = begin; i < end; i++) {
+                cv::Vec3i current = frontier[i];
+                if (!isBackground(views, model, current)) {
+                    continue;
+                }
+                model.set(current, Eigen::Vector4f(0, 0, 0, 0)); // masked pixel -> set alpha = 0
+
+                // add newly revealed neighbours to the next level
+                cv::Vec3i neighbours[6] = {
+                    cv::Vec3i(current(0) - 1, current(1), current(2)), cv::Vec3i(current(0) + 1, current(1), current(2)),
+                    cv::Vec3i(current(0), current(1) - 1, current(2)), cv::Vec3i(current(0), current(1) + 1, current(2)),
+                    cv::Vec3i(current(0), current(1), current(2) - 1), cv::Vec3i(current(0), current(1), current(2) + 1)
+                };
+                for (cv::Vec3i& neighbour : neighbours) {
+                    if (neighbour(0) < 0 || neighbour(0) >= model.getX() ||
+                        neighbour(1) < 0 || neighbour(1) >= model.getY() ||
+                        neighbour(2) < 0 || neighbour(2) >= model.getZ())
+                    {
+                        continue;
+                    }
+                    if (model.visit(neighbour)) {
+                        revealed.push_back(neighbour);
+                    }
+                }
+            }
+            std::lock_guard<std::mutex> lock(next_mutex);
+            next.insert(next.end(), revealed.begin(), revealed.end());
+        });
+        frontier.swap(next);
+        next.clear();
     }
     Benchmark::GetInstance().LogCarving(false);
     std::cout << "LOG - VC: carving complete." << std::endl;
 }
+
+// edge length of the blocks the hierarchical carving starts with
+#define HIERARCHICAL_BLOCK_SIZE 16
+// blocks with at most this many voxels are tested voxel by voxel instead of being split further
+#define HIERARCHICAL_MIN_BLOCK_VOLUME 8
+
+enum class Footprint {
+    Outside,    // all voxel centres project outside of the image
+    Background, // all voxel centres project onto background pixels
+    Foreground, // all voxel centres project onto foreground pixels
+    Mixed       // undecided, the block has to be split
+};
+
+// closed interval [lo, hi] for bounding the lens distortion over a block
+struct Interval {
+    float lo, hi;
+};
+
+static inline Interval operator+(Interval a, Interval b) {
+    return { a.lo + b.lo, a.hi + b.hi };
+}
+
+static inline Interval operator*(Interval a, Interval b) {
+    float p[4] = { a.lo * b.lo, a.lo * b.hi, a.hi * b.lo, a.hi * b.hi };
+    return { std::min(std::min(p[0], p[1]), std::min(p[2], p[3])), std::max(std::max(p[0], p[1]), std::max(p[2], p[3])) };
+}
+
+static inline Interval operator*(float k, Interval a) {
+    return k >= 0 ? Interval{ k * a.lo, k * a.hi } : Interval{ k * a.hi, k * a.lo };
+}
+
+static inline Interval square(Interval a) {
+    float lo = a.lo > 0 ? a.lo * a.lo : a.hi < 0 ? a.hi * a.hi : 0;
+    return { lo, std::max(a.lo * a.lo, a.hi * a.hi) };
+}
+
+/**
+ * @brief This function bounds the distorted pixel positions of all points of a rectangle in normalized camera coordinates.
+ * The distortion polynomial is evaluated in interval arithmetic, so the result holds for every point of the rectangle and any lens.
+ *
+ * @param lens      intrinsics and distortion coefficients
+ * @param min_u     in: minimum normalized x, out: minimum pixel x
+ * @param max_u     in: maximum normalized x, out: maximum pixel x
+ * @param min_v     in: minimum normalized y, out: minimum pixel y
+ * @param max_v     in: maximum normalized y, out: maximum pixel y
+ * @return bool     false if the rectangle reaches beyond lens.maxRadius2 or the rational model has no bound on it
+ */
+static bool distortedBounds(const LensModel& lens, float& min_u, float& max_u, float& min_v, float& max_v) {
+    Interval x = { min_u, max_u };
+    Interval y = { min_v, max_v };
+    Interval xx = square(x);
+    Interval yy = square(y);
+    Interval r2 = xx + yy;
+    if (!(r2.hi <= lens.maxRadius2)) {
+        return false;
+    }
+    Interval r4 = square(r2);
+    Interval r6 = r4 * r2;
+    Interval numerator = Interval{ 1, 1 } + lens.k1 * r2 + lens.k2 * r4 + lens.k3 * r6;
+    Interval denominator = Interval{ 1, 1 } + lens.k4 * r2 + lens.k5 * r4 + lens.k6 * r6;
+    if (!(denominator.lo > 0)) {
+        return false;
+    }
+    Interval radial = numerator * Interval{ 1 / denominator.hi, 1 / denominator.lo };
+    Interval xy = x * y;
+    Interval xd = x * radial + 2 * lens.p1 * xy + lens.p2 * (r2 + 2 * xx);
+    Interval yd = y * radial + lens.p1 * (r2 + 2 * yy) + 2 * lens.p2 * xy;
+    Interval u = lens.fx * xd + Interval{ lens.cx, lens.cx };
+    Interval v = lens.fy * yd + Interval{ lens.cy, lens.cy };
+    min_u = u.lo, max_u = u.hi, min_v = v.lo, max_v = v.hi;
+    return true;
+}
+
+/**
+ * @brief This function classifies the footprint of a block of voxels in a single view.
+ * The voxel centres of the block lie within the box spanned by its corner voxels, so they project into the bounding rectangle of the projected corners.
+ * For distorted projections the rectangle in normalized camera coordinates is bounded with distortedBounds, which holds for any lens within lens.maxRadius2.
+ *
+ * @param view          camera view
+ * @param model         voxel model
+ * @param min           first voxel of the block
+ * @param max           last voxel of the block (inclusive)
+ * @return Footprint    classification of the block
+ */
+static Footprint classifyBlock(CameraView& view, Model& model, cv::Vec3i min, cv::Vec3i max) {
+    // with distorted projections the corners are projected to normalized camera coordinates first
+    const float* P = view.distorted ? view.pose.ptr<float>() : view.projection.ptr<float>();
+    float min_u = FLT_MAX, max_u = -FLT_MAX, min_v = FLT_MAX, max_v = -FLT_MAX;
+    for (int corner = 0; corner < 8; corner++) {
+        cv::Vec4f world = model.toWord(corner & 1 ? max(0) : min(0), corner & 2 ? max(1) : min(1), corner & 4 ? max(2) : min(2));
+        float u = P[0] * world[0] + P[1] * world[1] + P[2] * world[2] + P[3] * world[3];
+        float v = P[4] * world[0] + P[5] * world[1] + P[6] * world[2] + P[7] * world[3];
+        float w = P[8] * world[0] + P[9] * world[1] + P[10] * world[2] + P[11] * world[3];
+        if (!(w > 0)) { // block reaches behind the camera, the rectangle is no bound
+            return Footprint::Mixed;
+        }
+        min_u = std::min(min_u, u / w);
+        max_u = std::max(max_u, u / w);
+        min_v = std::min(min_v, v / w);
+        max_v = std::max(max_v, v / w);
+    }
+    if (!(std::fabs(min_u) < 1e8f && std::fabs(max_u) < 1e8f && std::fabs(min_v) < 1e8f && std::fabs(max_v) < 1e8f)) {
+        return Footprint::Mixed;
+    }
+    if (view.distorted) {
+        // the distortion is bounded over the whole normalized rectangle, not only at sample points on it
+        if (!distortedBounds(view.lens, min_u, max_u, min_v, max_v)) {
+            return Footprint::Mixed;
+        }
+    }
+
+    // pixels hit by the rounded projections, padded by one pixel against rounding differences to the row projection of the voxels
+    int left = (int)std::floor(min_u) - 1;
+    int right = (int)std::ceil(max_u) + 1;
+    int top = (int)std::floor(min_v) - 1;
+    int bottom = (int)std::ceil(max_v) + 1;
+    if (right < view.borders.x || left >= view.borders.br().x || bottom < view.borders.y || top >= view.borders.br().y) {
+        return Footprint::Outside;
+    }
+    cv::Rect footprint(left, top, right - left + 1, bottom - top + 1);
+    if ((footprint & view.borders) != footprint) {
+        return Footprint::Mixed;
+    }
+
+    int background = view.countBackground(footprint);
+    if (background == footprint.area()) {
+        return Footprint::Background;
+    }
+    if (background == 0) {
+        return Footprint::Foreground;
+    }
+    return Footprint::Mixed;
+}
+
+/**
+ * @brief This function carves a single voxel using the given views (same test and same pixels as the standard carving, which projects rows).
+ */
+static void carveVoxel(ViewSet& views, const std::vector<int>& view_ids, Model& model, int x, int y, int z) {
+    cv::Vec4f row_start = model.rowStart(y, z);
+    for (int i : view_ids) {
+        cv::Point pixel_pos = views[i].projectRowPoint(row_start, model.rowStep(), model.rowPoint(x));
+        if (!pixel_pos.inside(views[i].borders))
+        {
+            continue;
+        }
+        cv::Vec3b pixel = views[i].mask.at<cv::Vec3b>(pixel_pos);
+        if (pixel(0) == 0 && pixel(1) == 0 && pixel(2) == 0) // masked pixel -> set alpha = 0
+        {
+            model.set(x, y, z, Eigen::Vector4f(0, 0, 0, 0));
+        }
+        model.see(x, y, z);
+    }
+}
+
+/**
+ * @brief This function carves the block [min, max) recursively.
+ * Views that keep a block (or don't see it) keep all of its sub blocks, so only undecided views are passed on.
+ *
+ * @param views         camera views
+ * @param view_ids      views that have not been decided for this block
+ * @param model         voxel model
+ * @param min           first voxel of the block
+ * @param max           voxel behind the last voxel of the block
+ * @param seen          whether one of the already decided views sees the block
+ */
+static void carveBlock(ViewSet& views, const std::vector<int>& view_ids, Model& model, cv::Vec3i min, cv::Vec3i max, bool seen) {
+    cv::Vec3i last = max - cv::Vec3i(1, 1, 1);
+    std::vector<int> mixed;
+    for (int i : view_ids) {
+        Footprint footprint = classifyBlock(views[i], model, min, last);
+        if (footprint == Footprint::Background) { // one view removes the whole block
+            for (int z = min(2); z < max(2); z++) {
+                for (int y = min(1); y < max(1); y++) {
+                    for (int x = min(0); x < max(0); x++) {
+                        model.set(x, y, z, Eigen::Vector4f(0, 0, 0, 0));
+                        model.see(x, y, z);
+                    }
+                }
+            }
+            return;
+        }
+        seen = seen || footprint == Footprint::Foreground;
+        if (footprint == Footprint::Mixed) {
+            mixed.push_back(i);
+        }
+    }
+
+    // every view keeps the whole block, or the block is small enough that testing its voxels is cheaper than splitting it
+    cv::Vec3i extent = max - min;
+    if (mixed.empty() || extent(0) * extent(1) * extent(2) <= HIERARCHICAL_MIN_BLOCK_VOLUME) {
+        for (int z = min(2); z < max(2); z++) {
+            for (int y = min(1); y < max(1); y++) {
+                for (int x = min(0); x < max(0); x++) {
+                    if (seen) {
+                        model.see(x, y, z);
+                    }
+                    if (!mixed.empty()) {
+                        carveVoxel(views, mixed, model, x, y, z);
+                    }
+                }
+            }
+        }
+        return;
+    }
+
+    // split every axis that is longer than one voxel
+    cv::Vec3i mid;
+    for (int i = 0; i < 3; i++) {
+        mid(i) = extent(i) > 1 ? (min(i) + max(i)) / 2 : max(i);
+    }
+    for (int child = 0; child < 8; child++) {
+        cv::Vec3i child_min, child_max;
+        for (int i = 0; i < 3; i++) {
+            bool upper = child & (1 << i);
+            child_min(i) = upper ? mid(i) : min(i);
+            child_max(i) = upper ? max(i) : mid(i);
+        }
+        if (child_min(0) < child_max(0) && child_min(1) < child_max(1) && child_min(2) < child_max(2)) {
+            carveBlock(views, mixed, model, child_min, child_max, seen);
+        }
+    }
+}
+
+void hierarchicalCarve(ViewSet& views, Model& model) {
+    std::cout << "LOG - VC: starting carving process (version 3, " << ThreadPool::GetInstance().GetThreadCount() << " threads)." << std::endl;
+    Benchmark::GetInstance().LogCarving(true);
+
+    // start with blocks of equal size, blocks are disjoint and can be carved concurrently
+    std::vector<cv::Vec3i> blocks;
+    for (int z = 0; z < model.getZ(); z += HIERARCHICAL_BLOCK_SIZE) {
+        for (int y = 0; y < model.getY(); y += HIERARCHICAL_BLOCK_SIZE) {
+            for (int x = 0; x < model.getX(); x += HIERARCHICAL_BLOCK_SIZE) {
+                blocks.push_back(cv::Vec3i(x, y, z));
+            }
+        }
+    }
+    std::vector<int> all_views;
+    for (int i = 0; i < views.size(); i++) {
+        all_views.push_back(i);
+    }
+    ThreadPool::GetInstance().ParallelFor(0, (int)blocks.size(), [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            cv::Vec3i max(std::min(blocks[i](0) + HIERARCHICAL_BLOCK_SIZE, model.getX()),
+                std::min(blocks[i](1) + HIERARCHICAL_BLOCK_SIZE, model.getY()),
+                std::min(blocks[i](2) + HIERARCHICAL_BLOCK_SIZE, model.getZ()));
+            carveBlock(views, all_views, model, blocks[i], max, false);
+        }
+    });
+
+    Benchmark::GetInstance().LogCarving(false);
+    std::cout << "LOG - VC: carving complete." << std::endl;
+}
+
+/**
+ * @brief This function allocates the bricks of a sparse model that has not been carved yet, leaving out the bricks
+ * whose voxel centres all project onto background in some view (they would be carved entirely).
+ */
+static void allocateBricks(ViewSet& views, Model& model) {
+    std::vector<cv::Vec3i> bricks = model.getBricks();
+    std::vector<char> kept(bricks.size());
+    ThreadPool::GetInstance().ParallelFor(0, (int)bricks.size(), [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            cv::Vec3i max = model.brickEnd(bricks[i]) - cv::Vec3i(1, 1, 1);
+            kept[i] = true;
+            for (CameraView& view : views) {
+                if (classifyBlock(view, model, bricks[i], max) == Footprint::Background) {
+                    kept[i] = false;
+                    break;
+                }
+            }
+        }
+    });
+
+    std::vector<cv::Vec3i> allocated;
+    for (size_t i = 0; i < bricks.size(); i++) {
+        if (kept[i]) {
+            allocated.push_back(bricks[i]);
+        }
+    }
+    model.allocateBricks(allocated);
+    std::cout << "LOG - VC: allocated " << allocated.size() << " of " << bricks.size() << " bricks." << std::endl;
+}
+
+// number of probe blocks along the longest axis of the box in each round of the fitting
+#define FIT_PROBE_BLOCKS 32
+// rounds of the fitting, each round probes the box of the previous one with smaller blocks
+#define FIT_PROBE_ROUNDS 2
+// carved voxels kept around the fitted box, so post processing behaves as in the requested grid
+#define FIT_MARGIN 2
+
+Model fitModel(ViewSet& views, int x, int y, int z, float size, ModelStorage storage, VoxelLayout layout) {
+    std::cout << "LOG - VC: fitting the grid to the visual hull (" << ThreadPool::GetInstance().GetThreadCount() << " threads)." << std::endl;
+    // classifyBlock only uses the coordinate mapping of the grid, which does not depend on its dimensions
+    Model lattice(1, 1, 1, size, ModelStorage::Compact);
+
+    cv::Vec3i begin(0, 0, 0), end(x, y, z);
+    for (int round = 0; round < FIT_PROBE_ROUNDS; round++) {
+        cv::Vec3i extent = end - begin;
+        int block = std::max(1, (std::max(extent(0), std::max(extent(1), extent(2))) + FIT_PROBE_BLOCKS - 1) / FIT_PROBE_BLOCKS);
+        cv::Vec3i blocks((extent(0) + block - 1) / block, (extent(1) + block - 1) / block, (extent(2) + block - 1) / block);
+
+        // a block is kept unless a view sees all of its voxel centres on background
+        std::vector<char> kept((size_t)blocks(0) * blocks(1) * blocks(2), 0);
+        ThreadPool::GetInstance().ParallelFor(0, blocks(2), [&](int z_begin, int z_end) {
+            for (int k = z_begin; k < z_end; k++) {
+                for (int j = 0; j < blocks(1); j++) {
+                    for (int i = 0; i < blocks(0); i++) {
+                        cv::Vec3i min = begin + cv::Vec3i(i, j, k) * block;
+                        cv::Vec3i max(std::min(min(0) + block, end(0)) - 1, std::min(min(1) + block, end(1)) - 1, std::min(min(2) + block, end(2)) - 1);
+                        bool background = false;
+                        for (CameraView& view : views) {
+                            if (classifyBlock(view, lattice, min, max) == Footprint::Background) {
+                                background = true;
+                                break;
+                            }
+                        }
+                        kept[i + (size_t)blocks(0) * (j + (size_t)blocks(1) * k)] = !background;
+                    }
+                }
+            }
+        });
+
+        cv::Vec3i kept_begin = end, kept_end = begin;
+        for (int k = 0; k < blocks(2); k++) {
+            for (int j = 0; j < blocks(1); j++) {
+                for (int i = 0; i < blocks(0); i++) {
+                    if (!kept[i + (size_t)blocks(0) * (j + (size_t)blocks(1) * k)]) {
+                        continue;
+                    }
+                    cv::Vec3i min = begin + cv::Vec3i(i, j, k) * block;
+                    for (int a = 0; a < 3; a++) {
+                        kept_begin(a) = std::min(kept_begin(a), min(a));
+                        kept_end(a) = std::max(kept_end(a), std::min(min(a) + block, end(a)));
+                    }
+                }
+            }
+        }
+        if (kept_begin(0) >= kept_end(0)) {
+            std::cout << "LOG - VC: no voxel is left by the probe carving, keeping the requested grid." << std::endl;
+            return Model(x, y, z, size, storage, cv::Vec3i(0, 0, 0), layout);
+        }
+        begin = kept_begin;
+        end = kept_end;
+        if (block == 1) {
+            break;
+        }
+    }
+
+    for (int a = 0; a < 3; a++) {
+        begin(a) = std::max(0, begin(a) - FIT_MARGIN);
+        end(a) = std::min(cv::Vec3i(x, y, z)(a), end(a) + FIT_MARGIN);
+    }
+    cv::Vec3i extent = end - begin;
+    double share = (double)extent(0) * extent(1) * extent(2) / ((double)x * y * z);
+    std::cout << "LOG - VC: fitted the grid to " << extent(0) << " x " << extent(1) << " x " << extent(2) << " voxels at offset (" << begin(0) << ", " << begin(1) << ", " << begin(2)
+        << "), " << std::round(share * 1000) / 10 << "% of the requested grid." << std::endl;
+    return Model(extent(0), extent(1), extent(2), size, storage, begin, layout);
+}
@@ -5,29 +5,119 @@
 
 
 #include "Model.h"
+#include "ViewSet.h"
 #include <opencv2/core/mat.hpp>
 
 /**
  * @brief This function carves a multiple frames out of the given model.
+ * By default a voxel is carved if the pixel under its centre is background. With a footprint level the whole projected voxel is tested instead,
+ * which keeps the silhouettes of coarse grids closer to the masks. Carved voxels are added to the carve record if the model keeps one.
  *
- * @param cameraMatrix	camera intrinsics
- * @param distCoeffs	distortion coefficients
- * @param model			voxel model
- * @param images		colored images to carve
- * @param masks			segmentation masks
+ * @param views				prepared camera views (poses, images and masks)
+ * @param model				voxel model
+ * @param intermediateMeshes	whether to generate a mesh after each frame
+ * @param footprint			carve voxels whose footprint has a foreground fraction below this level, 0 tests the centre pixel only
+ */
+void carve(ViewSet& views, Model& model, bool intermediateMeshes = false, float footprint = 0);
+
+/**
+ * @brief This function carves further frames out of a model that has been carved with other frames before (e.g. a snapshot).
+ * Only the new frames are tested (standard method), so the work does not depend on the number of frames carved before.
+ *
+ * @param views			prepared camera views (poses, images and masks)
+ * @param model			carved voxel model
+ * @param newViews		indices of the views to carve
+ * @return std::vector<cv::Vec3i>	surface voxels whose colors have to be reconstructed: voxels that were inner voxels before and surface voxels that one of
+ *									the new views sees, whose color in a run with all views depends on it
  */
-void carve(cv::Mat& cameraMatrix, cv::Mat& distCoeffs, Model& model, std::vector<cv::Mat>& images, std::vector<cv::Mat>& masks, bool intermediateMeshes = false);
+std::vector<cv::Vec3i> carveIncremental(ViewSet& views, Model& model, const std::vector<int>& newViews);
 
 /**
  * @brief This function carves a multiple frames out of the given model. Using a more error prone but significantly faster greedy approach compared to the standard method.
- * @see carve(cv::Mat& cameraMatrix, cv::Mat& distCoeffs, Model& model, std::vector<cv::Mat>& images, std::vector<cv::Mat>& masks)
+ * @see carve(ViewSet& views, Model& model)
+ *
+ * @param views			prepared camera views (poses, images and masks)
+ * @param model			voxel model
+ */
+void fastCarve(ViewSet& views, Model& model);
+
+/**
+ * @brief This function carves a multiple frames out of the given model. Produces the same result as the standard method,
+ * but decides whole blocks of voxels at once when their footprint (padded by a pixel) lies entirely in background or foreground of a mask
+ * and only subdivides blocks that straddle a silhouette edge. The voxels of undecided blocks are projected as points of their rows like there.
+ * @see carve(ViewSet& views, Model& model)
+ *
+ * @param views			prepared camera views (poses, images and masks)
+ * @param model			voxel model
+ */
+void hierarchicalCarve(ViewSet& views, Model& model);
+
+/**
+ * @brief This function carves a multiple frames out of the given model. Produces the same result as the standard method,
+ * but keeps the surviving voxels as runs of consecutive voxels between the frames, so every frame only tests the voxels that are left.
+ * @see carve(ViewSet& views, Model& model)
+ *
+ * @param views			prepared camera views (poses, images and masks)
+ * @param model			voxel model
+ * @param orderViews	whether to carve with the views that remove the most voxels first (estimated on a coarse sample of the grid)
+ */
+void survivorCarve(ViewSet& views, Model& model, bool orderViews = false);
+
+/**
+ * @brief This function carves a multiple frames out of the given model. Produces the same result as the standard method,
+ * but handles the grid column by column: the voxels of a z-column project onto a line segment, which is walked through the mask once per frame.
+ * Parts of the segment that lie entirely in background or foreground (with a margin of a pixel) decide their whole run of voxels at once,
+ * the surviving voxels are kept as z-intervals. Other voxels are projected as points of their rows like there.
+ * @see carve(ViewSet& views, Model& model)
  *
- * @param cameraMatrix	camera intrinsics
- * @param distCoeffs	distortion coefficients
+ * @param views			prepared camera views (poses, images and masks)
  * @param model			voxel model
- * @param images		colored images to carve
- * @param masks			segmentation masks
  */
-void fastCarve(cv::Mat& cameraMatrix, cv::Mat& distCoeffs, Model& model, std::vector<cv::Mat>& images, std::vector<cv::Mat>& masks);
+void columnCarve(ViewSet& views, Model& model);
+
+/**
+ * @brief This function carves a multiple frames out of the given model. Produces the same result as the standard method,
+ * but treats every z-slice of the grid as a plane that maps into each frame by a homography.
+ * The masks are warped into the slices and combined with dense image operations, slices are carved in parallel.
+ * The homography is evaluated in double precision, so a voxel whose centre projects within about 1e-3 pixels of a pixel edge can get
+ * the neighbouring pixel of the one of carve. Distorted views are projected as rows like there and match exactly.
+ * @see carve(ViewSet& views, Model& model)
+ *
+ * @param views			prepared camera views (poses, images and masks)
+ * @param model			voxel model
+ */
+void sliceCarve(ViewSet& views, Model& model);
+
+/**
+ * @brief This function carves a multiple frames out of the given model in image order: every background pixel of a mask casts a ray
+ * through the grid, which carves the voxels it crosses (if their centre projects onto background as well).
+ * The work depends on the number of background pixels instead of the grid volume, which pays off for close-ups.
+ * Voxels are marked as seen while the rays cross them, the others by the range of every grid row within each image, without projecting them.
+ * Unlike carve, a voxel is only carved if a ray crosses it: voxels that project to less than a pixel (or pixelStep pixels) can lie between
+ * the rays and are kept although their centre projects onto background, so the model can be larger than the one of carve.
+ * Crossed voxels are tested with the pixels of carve, so the model holds every voxel of the one of carve and the same voxels are seen.
+ * @see carve(ViewSet& views, Model& model)
+ *
+ * @param views			prepared camera views (poses, images and masks)
+ * @param model			voxel model
+ * @param pixelStep		only blocks of pixelStep x pixelStep pixels that are background only cast a ray (through their centre)
+ */
+void rayCarve(ViewSet& views, Model& model, int pixelStep = 1);
+
+/**
+ * @brief This function creates a model over the tight box of the visual hull within the requested grid, at the requested voxel size.
+ * Blocks of the grid are carved with a coarse probe that only removes blocks whose voxel centres all project onto background in some view,
+ * so carving the fitted model keeps the same voxels as carving the whole requested grid (all voxels outside of the box would be carved).
+ *
+ * @param views			prepared camera views (poses, images and masks)
+ * @param x				number of voxels of the requested grid in x direction
+ * @param y				number of voxels of the requested grid in y direction
+ * @param z				number of voxels of the requested grid in z direction
+ * @param size			side length of a voxel
+ * @param storage		memory layout of the model
+ * @param layout		order of the voxels of the model
+ * @return Model		model over the fitted box, offset to its place within the requested grid
+ */
+Model fitModel(ViewSet& views, int x, int y, int z, float size, ModelStorage storage = ModelStorage::Dense, VoxelLayout layout = VoxelLayout::Linear);
 
 #endif
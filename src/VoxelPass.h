@@ -0,0 +1,312 @@
+#pragma once
+
+#ifndef VOXEL_PASS_H
+#define VOXEL_PASS_H
+
+#include <cfloat>
+#include <cmath>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include <opencv2/core/mat.hpp>
+#include "Model.h"
+#include "ViewSet.h"
+#include "ThreadPool.h"
+
+/**
+ * @brief Carve policy of a voxel pass that keeps the occupancy of the model as it is (color reconstruction only).
+ */
+struct KeepOccupancy {
+	static constexpr bool carves = false;
+
+	static bool carvedBy(CameraView& view, const cv::Point& pixel_pos) { return false; }
+};
+
+/**
+ * @brief Carve policy of the standard carving: a voxel is carved if the pixel under its centre is background (all channels 0) in any view.
+ */
+struct CentreCarve {
+	static constexpr bool carves = true;
+
+	static bool carvedBy(CameraView& view, const cv::Point& pixel_pos) {
+		cv::Vec3b pixel = view.mask.at<cv::Vec3b>(pixel_pos);
+		return pixel(0) == 0 && pixel(1) == 0 && pixel(2) == 0;
+	}
+};
+
+/**
+ * @brief Color policy of a voxel pass that does not touch the colors of the model (carving only).
+ */
+struct NoColor {
+	static constexpr bool colors = false;
+
+	struct Accumulator {
+		void add(const Vector4f& color, float depth) {}
+		bool empty() const { return true; }
+		Vector4f result() const { return MODEL_COLOR; }
+	};
+};
+
+/**
+ * @brief Color policy that colors a surface voxel with the pixel of the closest view (first view on ties).
+ */
+struct ClosestColor {
+	static constexpr bool colors = true;
+
+	struct Accumulator {
+		Vector4f color = MODEL_COLOR;
+		float depth = FLT_MAX;
+		bool found = false;
+
+		void add(const Vector4f& c, float d) {
+			if (!found || d < depth) {
+				color = c;
+				depth = d;
+				found = true;
+			}
+		}
+		bool empty() const { return !found; }
+		Vector4f result() const { return color; }
+	};
+};
+
+/**
+ * @brief Color policy that colors a surface voxel with the rounded average of the pixels of all views that see it.
+ */
+struct AverageColor {
+	static constexpr bool colors = true;
+
+	struct Accumulator {
+		Vector4f sum = Vector4f(0, 0, 0, 0);
+		int count = 0;
+
+		void add(const Vector4f& c, float d) {
+			sum += c;
+			count++;
+		}
+		bool empty() const { return count == 0; }
+		Vector4f result() const {
+			Vector4f avg = sum / count;
+			return Vector4f(std::round(avg.x()), std::round(avg.y()), std::round(avg.z()), 1);
+		}
+	};
+};
+
+/**
+ * @brief Single traversal of the grid that carves and colors the model with the given policies, which are resolved at compile time.
+ * The grid is processed slice by slice (z): a slice is carved with all views at once, its pixel positions are kept and reused to color
+ * the surface voxels of the slice before it, whose neighbours are final at that point. The result is the same as carving with all
+ * views first and reconstructing the colors afterwards, without a second sweep over the grid and its projections: every path projects
+ * a voxel as a point of its row (Model::rowStart), so they all use the same pixel for it.
+ * Carving passes need dense or compact models. Without carving, the model is walked brick by brick (Model::getBricks)
+ * and only the brick rows holding surface voxels are projected, so sparse models are only visited where they hold voxels.
+ * The views seeing a voxel are folded into the fixed size Accumulator of the color policy one after the other, observed colors are never stored.
+ * Storage and layout of the model are resolved once per pass (dispatchVoxelAccess), the loops are instantiated for each of them.
+ *
+ * @tparam CarvePolicy	KeepOccupancy or CentreCarve
+ * @tparam ColorPolicy	NoColor, ClosestColor or AverageColor
+ */
+template <class CarvePolicy, class ColorPolicy>
+class VoxelPass {
+public:
+	/**
+	 * @brief Runs the pass over the whole model.
+	 *
+	 * @param views		prepared camera views (poses, images and masks)
+	 * @param model		voxel model
+	 */
+	static void run(ViewSet& views, Model& model) {
+		dispatchVoxelAccess(model, [&](auto& grid) { pass(views, grid); });
+	}
+
+	/**
+	 * @brief Colors the given surface voxels only, with all views.
+	 *
+	 * @param views		prepared camera views (poses, images and masks)
+	 * @param model		voxel model
+	 * @param voxels	surface voxels of the model
+	 */
+	static void colorVoxels(ViewSet& views, Model& model, const std::vector<cv::Vec3i>& voxels) {
+		dispatchVoxelAccess(model, [&](auto& grid) { colorList(views, grid, voxels); });
+	}
+
+private:
+	template <class Grid>
+	static void pass(ViewSet& views, Grid& model) {
+		if (!CarvePolicy::carves) {
+			if (ColorPolicy::colors) {
+				colorBricks(views, model);
+			}
+			return;
+		}
+
+		size_t slice = (size_t)model.getX() * model.getY();
+		size_t cache = slice * views.size();
+
+		// pixel positions of two consecutive slices in all views (view major)
+		std::vector<int> px(2 * cache), py(2 * cache);
+		std::vector<Vector4f> colors(ColorPolicy::colors ? slice : 0);
+		for (int z = 0; z <= model.getZ(); z++) {
+			if (z < model.getZ()) {
+				carveSlice(views, model, z, &px[(z & 1) * cache], &py[(z & 1) * cache]);
+			}
+			if (ColorPolicy::colors && z > 0) {
+				colorSlice(views, model, z - 1, &px[((z - 1) & 1) * cache], &py[((z - 1) & 1) * cache], colors);
+			}
+		}
+	}
+
+	template <class Grid>
+	static void colorList(ViewSet& views, Grid& model, const std::vector<cv::Vec3i>& voxels) {
+		std::vector<Vector4f> colors(voxels.size());
+		std::vector<char> found(voxels.size());
+		ThreadPool::GetInstance().ParallelFor(0, (int)voxels.size(), [&](int begin, int end) {
+			for (int i = begin; i < end; i++) {
+				found[i] = colorVoxel(views, model, voxels[i](0), voxels[i](1), voxels[i](2), nullptr, nullptr, 0, colors[i]);
+			}
+		});
+
+		// setting colors is not thread safe for compact and sparse models
+		for (size_t i = 0; i < voxels.size(); i++) {
+			if (found[i]) {
+				model.set(voxels[i], colors[i]);
+			}
+		}
+	}
+
+	/**
+	 * @brief Color of a surface voxel, pixel positions are read from px/py (stride elements per view) if given and projected
+	 * as a point of the voxel's row otherwise, which gives the same pixels as the rows of carveSlice.
+	 *
+	 * @return bool		whether any view sees the voxel
+	 */
+	template <class Grid>
+	static bool colorVoxel(ViewSet& views, Grid& model, int x, int y, int z, const int* px, const int* py, size_t stride, Vector4f& color) {
+		cv::Vec4f word_coord = model.toWord(x, y, z);
+		cv::Vec4f row_start = model.rowStart(y, z);
+		cv::Vec4f x_step = model.rowStep();
+		typename ColorPolicy::Accumulator accumulator;
+		for (int v = 0; v < views.size(); v++) {
+			CameraView& view = views[v];
+			cv::Point pixel_pos = px ? cv::Point(px[v * stride], py[v * stride]) : view.projectRowPoint(row_start, x_step, model.rowPoint(x));
+			if (!pixel_pos.inside(view.borders)) {
+				continue;
+			}
+			cv::Vec3b pixel = view.image.at<cv::Vec3b>(pixel_pos);
+			accumulator.add(Vector4f(pixel(2), pixel(1), pixel(0), 1), (float)cv::norm(view.center - word_coord));
+		}
+		if (accumulator.empty()) {
+			return false;
+		}
+		color = accumulator.result();
+		return true;
+	}
+
+	template <class Grid>
+	static void colorBricks(ViewSet& views, Grid& model) {
+		std::vector<cv::Vec3i> bricks = model.getBricks();
+		std::vector<std::pair<cv::Vec3i, Vector4f>> colors;
+		std::mutex colors_mutex;
+		cv::Vec4f x_step = model.rowStep();
+		ThreadPool::GetInstance().ParallelFor(0, (int)bricks.size(), [&](int begin, int end) {
+			std::vector<std::pair<cv::Vec3i, Vector4f>> chunk_colors;
+			std::vector<char> surface;
+			std::vector<int> px, py;
+			for (int b = begin; b < end; b++) {
+				cv::Vec3i min = bricks[b], max = model.brickEnd(bricks[b]);
+				int n = max(0) - min(0);
+				surface.resize(n);
+				px.resize(n * views.size());
+				py.resize(n * views.size());
+				for (int z = min(2); z < max(2); z++) {
+					for (int y = min(1); y < max(1); y++) {
+						bool any = false;
+						for (int x = min(0); x < max(0); x++) {
+							surface[x - min(0)] = model.isOccupied(x, y, z) && !model.isInner(x, y, z);
+							any = any || surface[x - min(0)];
+						}
+						if (!any) {
+							continue;
+						}
+						// rows with surface voxels are projected as carveSlice projects them
+						for (int v = 0; v < views.size(); v++) {
+							views[v].projectRow(model.rowStart(y, z), x_step, n, &px[v * n], &py[v * n], model.rowPoint(min(0)));
+						}
+						for (int x = min(0); x < max(0); x++) {
+							Vector4f color;
+							if (surface[x - min(0)] && colorVoxel(views, model, x, y, z, &px[x - min(0)], &py[x - min(0)], n, color)) {
+								chunk_colors.push_back(std::make_pair(cv::Vec3i(x, y, z), color));
+							}
+						}
+					}
+				}
+			}
+			std::lock_guard<std::mutex> lock(colors_mutex);
+			colors.insert(colors.end(), chunk_colors.begin(), chunk_colors.end());
+		});
+
+		// setting colors is not thread safe for compact and sparse models
+		for (const std::pair<cv::Vec3i, Vector4f>& color : colors) {
+			model.set(color.first, color.second);
+		}
+	}
+
+	template <class Grid>
+	static void carveSlice(ViewSet& views, Grid& model, int z, int* px, int* py) {
+		size_t slice = (size_t)model.getX() * model.getY();
+		cv::Vec4f x_step = model.rowStep();
+		ThreadPool::GetInstance().ParallelFor(0, model.getY(), [&](int y_begin, int y_end) {
+			for (int y = y_begin; y < y_end; y++) {
+				size_t row = (size_t)y * model.getX();
+				for (int v = 0; v < views.size(); v++) {
+					views[v].projectRow(model.rowStart(y, z), x_step, model.getX(), px + v * slice + row, py + v * slice + row, model.rowPoint(0));
+				}
+				for (int x = 0; x < model.getX(); x++) {
+					if (!model.isOccupied(x, y, z)) {
+						continue;
+					}
+					for (int v = 0; v < views.size(); v++) {
+						cv::Point pixel_pos(px[v * slice + row + x], py[v * slice + row + x]);
+						if (!pixel_pos.inside(views[v].borders)) {
+							continue;
+						}
+						model.see(x, y, z);
+						// carved voxels are seen already, the remaining views can't change them anymore
+						if (CarvePolicy::carvedBy(views[v], pixel_pos)) {
+							model.set(x, y, z, Vector4f(0, 0, 0, 0));
+							break;
+						}
+					}
+				}
+			}
+		});
+	}
+
+	template <class Grid>
+	static void colorSlice(ViewSet& views, Grid& model, int z, int* px, int* py, std::vector<Vector4f>& colors) {
+		size_t slice = (size_t)model.getX() * model.getY();
+		ThreadPool::GetInstance().ParallelFor(0, model.getY(), [&](int y_begin, int y_end) {
+			for (int y = y_begin; y < y_end; y++) {
+				for (int x = 0; x < model.getX(); x++) {
+					size_t i = (size_t)y * model.getX() + x;
+					colors[i].w() = 0;
+					if (model.isOccupied(x, y, z) && !model.isInner(x, y, z)) {
+						colorVoxel(views, model, x, y, z, px + i, py + i, slice, colors[i]);
+					}
+				}
+			}
+		});
+
+		// colors of compact models are kept in a map, which can't be written concurrently
+		for (int y = 0; y < model.getY(); y++) {
+			for (int x = 0; x < model.getX(); x++) {
+				const Vector4f& color = colors[(size_t)y * model.getX() + x];
+				if (color.w() != 0) {
+					model.set(x, y, z, color);
+				}
+			}
+		}
+	}
+};
+
+#endif
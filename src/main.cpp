@@ -1,32 +1,58 @@
 #include <vector>
+#include <algorithm>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <filesystem>
 #include "Calibration.h"
 #include "PoseEstimation.h"
 #include "Segmentation.h"
+#include "ViewSet.h"
 #include "VoxelCarving.h"
 #include "ColorReconstruction.h"
 #include "MarchingCubes.h"
 #include "Postprocessing3d.h"
+#include "TiledReconstruction.h"
 #include "Benchmark.h"
+#include "ThreadPool.h"
+#include "Checks.h"
 namespace fs = std::filesystem;
 namespace {
 	const char* about =
 		"AR Voxel Carving Project\n";
 	const char* keys =
-		"{c        		|       | 1 for AruCo board creation, 2 for camera calibration, 3 for pose estimation, 5 for carving, 6 for predefined benchmarking}"
+		"{c        		|       | 1 for AruCo board creation, 2 for camera calibration, 3 for pose estimation, 5 for carving, 6 for predefined benchmarking, 7 for consistency checks}"
 		"{resize        | 1.0   | Resize the image preview during calibration by this factor (for very high/low res cameras)}"
 		"{live          | true  | Whether to use live camera calibration, otherwise images will be taken from the folder provided to -images}"
 		"{cam_id        | 0     | ID of the connected camera to be used when performing live calibration}"
 		"{images        |       | Give the path to the directory containing the images for pose estimation/carving}"
 		"{calibration   | out/cameracalibration.yml | Give the path to the result of the camera calibration (eg. kinect_v1.yml)}"
 		"{video_id      | -1    | Give the id to the video stream for which you want to estimate the pose}"
-		"{carve         | 1     | 1 for standard carving, 2 for fast carving}"
+		"{carve         | 1     | 1 for standard carving, 2 for fast carving, 3 for hierarchical carving, 4 for survivor carving, 5 for column carving, 6 for slice carving, 7 for ray carving}"
+		"{orderViews    | false | Whether to carve with the views that remove the most voxels first (only carving method 4).}"
+		"{footprint     | 0.0   | Carve voxels whose projected footprint has a foreground fraction below this level, 0 only tests the centre pixel (only carving method 1).}"
+		"{coverage      | false | Whether to keep the fractional coverage of the voxels so the mesh surface lies between voxels (only carving method 1).}"
+		"{removeViews   |       | Comma separated indices (below 64) of views whose carving is undone, e.g. frames with a wrong pose (only carving method 1).}"
+		"{minCarveViews | 1     | Only carve voxels that are carved by at least this many views (only carving method 1).}"
+		"{rayStep       | 1     | Only every n-th pixel in each direction casts a ray (only carving method 7).}"
+		"{threads       | 1     | Number of threads used for carving, 0 uses all hardware threads.}"
+		"{distorted     | false | Whether to apply the lens distortion to the projected voxels instead of undistorting images and masks.}"
 		"{masks         |       | Give the path to the directory containing the image masks}"
 		"{x             | 100   | Give the number of voxels in x direction.}"
 		"{y             | 100   | Give the number of voxels in y direction.}"
 		"{z             | 100   | Give the number of voxels in z direction.}"
 		"{size          | 0.0028| Give the side length of a voxel.}"
+		"{fit           | false | Whether to shrink the grid to the bounding box of the visual hull (found by a coarse probe carving) before carving.}"
+		"{compact       | false | Whether to store the model bit-packed (1 bit occupancy, colors only for surface voxels) to reduce memory.}"
+		"{bricked       | false | Whether to order the voxels in memory in 8^3 bricks instead of x-fastest slices, so the neighbourhoods of voxels stay in cache.}"
+		"{padded        | false | Whether to surround the voxels with a ghost layer and pad rows and slices to powers of two, so neighbours are read without bounds checks.}"
+		"{payload       | 3     | Voxel payload of the model unless compact or sparse: 1 occupancy bit (compact), 2 RGBA8, 3 float RGBA.}"
+		"{snapshot      |       | Write a binary snapshot of the carved and colored model to this file, which -resume can continue from.}"
+		"{resume        |       | Continue from a snapshot (-snapshot) instead of carving, only color reconstruction, postprocessing and meshing run.}"
+		"{incremental   | false | Carve the images that are not part of the snapshot yet into it (-resume) and color the voxels they expose.}"
+		"{memoryBudget  | 0     | Reconstruct the grid tile by tile so the voxels of a tile take at most this many MB, 0 reconstructs the whole grid at once.}"
+		"{backingFile   | out/voxels.bin | File the carved and colored voxels are streamed to when reconstructing tile by tile.}"
+		"{sparse        | false | Whether to store the model as a hash map of 8^3 bricks, which are only allocated where carving leaves voxels (only carving method 1).}"
 		"{color         | 0     | 0 for no color reconstruction, 1 for nearest camera, 2 for average color.}"
 		"{scale         | 1.0   | Give the scale factor for the output model.}"
 		"{dx            | 0.0   | Move model in x direction (unscaled).}"
@@ -53,6 +79,13 @@ int main(int argc, char* argv[])
 	}
 	int choose = parser.get<int>("c");
 
+	int threads = parser.get<int>("threads");
+	if (threads < 0) {
+		std::cerr << "You need to define a non-negative number of threads. (--threads)" << std::endl;
+		return 0;
+	}
+	ThreadPool::GetInstance().SetThreadCount(threads);
+
 	switch (choose) { // entry point for all parts of the program
 	case 1: { // generate a charuco board and save it as an image file (print on paper to use for camera calibration and pose estimation)
 		Calibration cal{};
@@ -184,10 +217,82 @@ int main(int argc, char* argv[])
 	case 5: // voxel carving
 	{
 		int carveArg = parser.get<int>("carve");
-		if (carveArg < 1 || 2 < carveArg) {
+		if (carveArg < 1 || 7 < carveArg) {
 			std::cerr << "Invalid carve argument.";
 			break;
 		}
+		float footprint = parser.get<float>("footprint");
+		if (footprint < 0 || 1 < footprint) {
+			std::cerr << "You need to define a footprint level between 0 and 1. (--footprint)";
+			break;
+		}
+		if (parser.get<bool>("coverage") && carveArg != 1) {
+			std::cerr << "Fractional coverage is only supported by the standard carving. (--coverage)";
+			break;
+		}
+		int minCarveViews = parser.get<int>("minCarveViews");
+		if (minCarveViews < 1) {
+			std::cerr << "You need to define a strictly positive number of views to carve a voxel. (--minCarveViews)";
+			break;
+		}
+		uint64_t removedViews = 0;
+		std::stringstream removeViews(parser.get<std::string>("removeViews"));
+		std::string removeView;
+		bool validRemoveViews = true;
+		while (std::getline(removeViews, removeView, ',')) {
+			int view = removeView.empty() ? -1 : std::atoi(removeView.c_str());
+			if (view < 0 || 63 < view) {
+				validRemoveViews = false;
+				break;
+			}
+			removedViews |= uint64_t(1) << view;
+		}
+		if (!validRemoveViews) {
+			std::cerr << "You need to define comma separated view indices between 0 and 63. (--removeViews)";
+			break;
+		}
+		bool carveRecord = removedViews != 0 || minCarveViews > 1;
+		if (carveRecord && carveArg != 1) {
+			std::cerr << "Removing views and voting are only supported by the standard carving. (--removeViews/--minCarveViews)";
+			break;
+		}
+		if (parser.get<bool>("sparse") && (carveArg != 1 || parser.get<bool>("coverage") || carveRecord)) {
+			std::cerr << "Sparse models are only supported by the standard carving without coverage and carve record. (--sparse)";
+			break;
+		}
+		int memoryBudget = parser.get<int>("memoryBudget");
+		if (memoryBudget < 0) {
+			std::cerr << "You need to define a memory budget of at least 0 MB. (--memoryBudget)";
+			break;
+		}
+		if (memoryBudget > 0 && (parser.get<bool>("fit") || parser.get<bool>("sparse") || parser.get<bool>("coverage") || carveRecord
+			|| parser.get<bool>("intermediateMesh") || parser.get<bool>("model_debug"))) {
+			std::cerr << "Tiled reconstruction doesn't support fitting, sparse models, coverage, carve record, intermediate meshes and debug meshes. (--memoryBudget)";
+			break;
+		}
+		std::string resume = parser.get<std::string>("resume");
+		if ((!resume.empty() || !parser.get<std::string>("snapshot").empty()) && memoryBudget > 0) {
+			std::cerr << "Snapshots are not supported by the tiled reconstruction. (--snapshot/--resume)";
+			break;
+		}
+		bool incremental = parser.get<bool>("incremental");
+		if (incremental && resume.empty()) {
+			std::cerr << "Incremental carving continues from a snapshot. (--incremental/--resume)";
+			break;
+		}
+		// 100, 100, 100, 0.0028 ~ Caruco
+		std::unique_ptr<Model> model;
+		if (!resume.empty()) {
+			// the snapshot brings its own grid, it is mapped instead of carved
+			model = Model::ReadSnapshot(resume);
+			if (!model) {
+				break;
+			}
+		}
+		if (parser.get<int>("rayStep") < 1) {
+			std::cerr << "You need to define a strictly positive ray step. (--rayStep)";
+			break;
+		}
 		// we read both images and masks for voxel carving
 		// the masks are used for the actual carving, the images allow us to reconstruct color
 		std::string image_dir = parser.get<std::string>("images");
@@ -202,9 +307,26 @@ int main(int argc, char* argv[])
 
 		std::vector<std::string> image_filenames;
 		cv::glob(image_dir, image_filenames);
+		// images that have not been carved into the snapshot yet, the others are only loaded where their colors are needed (after carving)
+		std::vector<int> newViews;
+		std::vector<bool> loadView(image_filenames.size(), true);
+		if (incremental) {
+			std::vector<AppliedView>& applied = model->getAppliedViews();
+			for (int i = 0; i < image_filenames.size(); i++) {
+				std::string name = fs::path(image_filenames[i]).filename().string();
+				bool isNew = std::none_of(applied.begin(), applied.end(), [&](const AppliedView& view) { return view.name == name; });
+				if (isNew) {
+					newViews.push_back(i);
+				}
+				loadView[i] = isNew;
+			}
+			std::cout << "LOG - VC: incremental carving with " << newViews.size() << " new views (" << applied.size() << " applied before)." << std::endl;
+		}
 		std::vector<cv::Mat> images;
 		for (int i = 0; i < image_filenames.size(); i++) {
-			images.push_back(cv::imread(image_filenames[i], 1));
+			if (loadView[i]) {
+				images.push_back(cv::imread(image_filenames[i], 1));
+			}
 		}
 
 		std::cout << "LOG - VC: images read." << std::endl;
@@ -220,12 +342,14 @@ int main(int argc, char* argv[])
 		cv::glob(masks_dir, mask_filenames);
 		std::vector<cv::Mat> masks;
 		for (int i = 0; i < mask_filenames.size(); i++) {
-			masks.push_back(cv::imread(mask_filenames[i], 1));
+			if (i >= loadView.size() || loadView[i]) {
+				masks.push_back(cv::imread(mask_filenames[i], 1));
+			}
 		}
 
 		std::cout << "LOG - VC: masks read." << std::endl;
 
-		if (images.size() != masks.size()) {
+		if (image_filenames.size() != mask_filenames.size()) {
 			std::cerr << "Number of images doesn't match number of masks." << std::endl;
 			break;
 		}
@@ -244,9 +368,6 @@ int main(int argc, char* argv[])
 			std::cerr << "You need to define a strictly positive voxel size. (--size)";
 			break;
 		}
-		// 100, 100, 100, 0.0028 ~ Caruco
-		Model model = Model(x, y, z, size);
-
 		cv::Mat cameraMatrix, distCoeffs;
 		if (parser.get<std::string>("calibration").empty())
 		{
@@ -256,51 +377,174 @@ int main(int argc, char* argv[])
 		loadCalibrationFile(parser.get<std::string>("calibration"), &cameraMatrix, &distCoeffs);
 		std::cout << "LOG - VC: read cameraMatrix and distCoefficients." << std::endl;
 
-		// carve
-		switch (carveArg)
+		int color = parser.get<int>("color");
+		if (color < 0 || 2 < color)
 		{
-		case 1: carve(cameraMatrix, distCoeffs, model, images, masks, parser.get<bool>("intermediateMesh"));
+			std::cerr << "You need to select a predefined color reconstruction mode. (--color)";
 			break;
-		case 2: fastCarve(cameraMatrix, distCoeffs, model, images, masks);
+		}
+		if (parser.get<bool>("bricked") && parser.get<bool>("padded")) {
+			std::cerr << "The voxels can either be ordered in bricks or padded. (--bricked/--padded)";
 			break;
-		default:
-			std::cerr << "Ups, something went wrong!" << std::endl;
 		}
-
-		// color reconstruction
-		int color = parser.get<int>("color");
-		if (color < 0 || 3 < color)
+		int payload = parser.get<int>("payload");
+		if (payload < 1 || 3 < payload)
 		{
-			std::cerr << "You need to select a predefined color reconstruction mode. (--color)";
+			std::cerr << "You need to select a predefined voxel payload. (--payload)";
 			break;
 		}
+		// the standard carving colors the model in the same pass unless it has to go view by view
+		bool fused = carveArg == 1 && color != 0 && footprint == 0 && !parser.get<bool>("coverage") && !carveRecord && !parser.get<bool>("intermediateMesh") && !parser.get<bool>("sparse") && resume.empty();
+
+		// estimate poses and undistort images/masks once for all stages
+		ViewSet views(cameraMatrix, distCoeffs, images, masks, parser.get<bool>("distorted"));
+
+		// carving and color reconstruction of the whole grid or of a tile
+		auto carveModel = [&](Model& model) {
+			switch (carveArg)
+			{
+			case 1:
+				if (fused) {
+					carveAndReconstructColor(views, model, color);
+				}
+				else {
+					carve(views, model, parser.get<bool>("intermediateMesh"), footprint);
+				}
+				break;
+			case 2: fastCarve(views, model);
+				break;
+			case 3: hierarchicalCarve(views, model);
+				break;
+			case 4: survivorCarve(views, model, parser.get<bool>("orderViews"));
+				break;
+			case 5: columnCarve(views, model);
+				break;
+			case 6: sliceCarve(views, model);
+				break;
+			case 7: rayCarve(views, model, parser.get<int>("rayStep"));
+				break;
+			default:
+				std::cerr << "Ups, something went wrong!" << std::endl;
+			}
+			if (carveRecord) {
+				model.applyCarveRecord(minCarveViews, removedViews);
+			}
+		};
+		auto colorModel = [&](Model& model) {
+			switch (fused ? 0 : color)
+			{
+			case 0:
+				break;
+			case 1: reconstructClosestColor(views, model);
+				break;
+			case 2: reconstructAvgColor(views, model);
+				break;
+			default:
+				std::cerr << "Ups, something went wrong!" << std::endl;
+			}
+		};
 
-		switch (color)
-		{
-		case 0:
-			break;
-		case 1: reconstructClosestColor(cameraMatrix, distCoeffs, model, images, masks);
-			break;
-		case 2: reconstructAvgColor(cameraMatrix, distCoeffs, model, images, masks);
+		ModelStorage storage = parser.get<bool>("sparse") ? ModelStorage::Sparse : parser.get<bool>("compact") || payload == 1 ? ModelStorage::Compact
+			: payload == 2 ? ModelStorage::RGBA8 : ModelStorage::Dense;
+		VoxelLayout layout = parser.get<bool>("bricked") ? VoxelLayout::Bricked : parser.get<bool>("padded") ? VoxelLayout::Padded : VoxelLayout::Linear;
+		Vector3f modelTranslation = Vector3f(parser.get<float>("dx"), parser.get<float>("dy"), parser.get<float>("dz"));
+		if (memoryBudget > 0) {
+			reconstructTiled(x, y, z, size, storage, layout, (size_t)memoryBudget * 1024 * 1024, parser.get<std::string>("backingFile"), [&](Model& tile) { carveModel(tile); colorModel(tile); },
+				parser.get<bool>("postprocessing") ? 3 : 1, parser.get<float>("scale"), modelTranslation, parser.get<std::string>("outFile"));
 			break;
-		default:
-			std::cerr << "Ups, something went wrong!" << std::endl;
+		}
+
+		if (incremental) {
+			// the views hold the new images only, old ones are added where their colors are needed
+			std::vector<int> carveViews(views.size());
+			for (int i = 0; i < carveViews.size(); i++) {
+				carveViews[i] = i;
+			}
+			std::vector<cv::Vec3i> recolor = carveIncremental(views, *model, carveViews);
+			std::vector<AppliedView>& applied = model->getAppliedViews();
+			if (!model->hasCalibration(cameraMatrix, distCoeffs)) {
+				// poses of another calibration (or of snapshots without calibration) are estimated again where the old views are loaded
+				for (AppliedView& view : applied) {
+					view.hasPose = false;
+				}
+				model->setCalibration(cameraMatrix, distCoeffs);
+			}
+			if (color != 0 && !recolor.empty()) {
+				// old views with a stored pose are only loaded if they see one of the voxels to color
+				ViewSet oldViews(cameraMatrix, distCoeffs, parser.get<bool>("distorted"));
+				std::vector<int> posedFiles, unposedFiles, unposedViews;
+				for (int j = 0; j < applied.size(); j++) {
+					auto file = std::find_if(image_filenames.begin(), image_filenames.end(), [&](const std::string& filename) {
+						return fs::path(filename).filename().string() == applied[j].name;
+					});
+					if (file == image_filenames.end()) { // not part of the images anymore
+						continue;
+					}
+					if (applied[j].hasPose) {
+						oldViews.addView(cv::Mat(applied[j].pose), applied[j].size);
+						posedFiles.push_back((int)(file - image_filenames.begin()));
+					}
+					else {
+						unposedFiles.push_back((int)(file - image_filenames.begin()));
+						unposedViews.push_back(j);
+					}
+				}
+				cv::Mat noMask;
+				std::vector<int> seeing = viewsSeeing(oldViews, *model, recolor);
+				for (int v : seeing) {
+					cv::Mat image = cv::imread(image_filenames[posedFiles[v]], 1);
+					views.addView(oldViews[v].pose, oldViews[v].borders.size());
+					views.setFrames(views.size() - 1, image, noMask);
+				}
+				for (int k = 0; k < unposedFiles.size(); k++) {
+					cv::Mat image = cv::imread(image_filenames[unposedFiles[k]], 1);
+					views.addView(image, noMask);
+					applied[unposedViews[k]] = AppliedView(applied[unposedViews[k]].name, views[views.size() - 1].pose, image.size());
+				}
+				std::cout << "LOG - CR: loaded " << seeing.size() + unposedFiles.size() << " of " << applied.size() << " old views to color "
+					<< recolor.size() << " voxels (" << unposedFiles.size() << " without stored pose)." << std::endl;
+				reconstructColor(views, *model, color, recolor);
+			}
+			for (int k = 0; k < newViews.size(); k++) {
+				applied.push_back(AppliedView(fs::path(image_filenames[newViews[k]]).filename().string(), views[k].pose, views[k].borders.size()));
+			}
+		}
+		else if (resume.empty()) {
+			model = std::make_unique<Model>(parser.get<bool>("fit") ? fitModel(views, x, y, z, size, storage, layout) : Model(x, y, z, size, storage, cv::Vec3i(0, 0, 0), layout));
+			if (parser.get<bool>("coverage")) {
+				model->enableCoverage();
+			}
+			if (carveRecord) {
+				model->enableCarveRecord();
+			}
+			carveModel(*model);
+			// poses are kept by snapshots, so incremental runs don't estimate them again
+			for (int i = 0; i < image_filenames.size(); i++) {
+				model->getAppliedViews().push_back(AppliedView(fs::path(image_filenames[i]).filename().string(), views[i].pose, views[i].borders.size()));
+			}
+			model->setCalibration(cameraMatrix, distCoeffs);
+		}
+		if (!incremental) {
+			colorModel(*model);
+		}
+
+		if (!parser.get<std::string>("snapshot").empty()) {
+			model->WriteSnapshot(parser.get<std::string>("snapshot"));
 		}
 
 		//apply postprocessing
-		model.handleUnseen();
+		model->handleUnseen();
 
 		if (parser.get<bool>("model_debug")) {
-			model.WriteModel();
+			model->WriteModel();
 		}
 
 		if (parser.get<bool>("postprocessing")) {
-			applyClosure(&model, 3);
+			applyClosure(model.get(), 3);
 		}
 
 		//generate triangle mesh
-		Vector3f modelTranslation = Vector3f(parser.get<float>("dx"), parser.get<float>("dy"), parser.get<float>("dz"));
-		marchingCubes(&model, parser.get<float>("scale"), modelTranslation, 0.5f, parser.get<std::string>("outFile"));
+		marchingCubes(model.get(), parser.get<float>("scale"), modelTranslation, 0.5f, parser.get<std::string>("outFile"));
 	}
 	break;
 	case 6: // benchmarking, shows runtime of individual steps of the program (segmentation, voxel carving, post-processing)
@@ -344,14 +588,17 @@ int main(int argc, char* argv[])
 		loadCalibrationFile(parser.get<std::string>("calibration"), &cameraMatrix, &distCoeffs);
 		std::cout << "LOG - Benchmark: read cameraMatrix and distCoefficients." << std::endl;
 
+		// views are shared by all runs, pose estimation and undistortion are not part of the measured times
+		ViewSet views(cameraMatrix, distCoeffs, images, masks, parser.get<bool>("distorted"));
+
 		std::filesystem::create_directories("./out/bench");
 		// perform benchmarks here
 		// small, v1, avg coloring
 		Benchmark::GetInstance().NextRun("Small, V1, avg. coloring\t", Vector4f(10, 10, 5, 0.028f));
 		Benchmark::GetInstance().LogOverall(true);
 		Model model = Model(10, 10, 5, 0.028f);
-		carve(cameraMatrix, distCoeffs, model, images, masks);
-		reconstructAvgColor(cameraMatrix, distCoeffs, model, images, masks);
+		carve(views, model);
+		reconstructAvgColor(views, model);
 		model.handleUnseen();
 		applyClosure(&model, 3);
 		Vector3f modelTranslation = Vector3f(parser.get<float>("dx"), parser.get<float>("dy"), parser.get<float>("dz"));
@@ -362,8 +609,8 @@ int main(int argc, char* argv[])
 		Benchmark::GetInstance().NextRun("Medium, V1, avg. coloring\t", Vector4f(50, 50, 25, 0.0056f));
 		Benchmark::GetInstance().LogOverall(true);
 		Model model2 = Model(50, 50, 25, 0.0056f);
-		carve(cameraMatrix, distCoeffs, model2, images, masks);
-		reconstructAvgColor(cameraMatrix, distCoeffs, model2, images, masks);
+		carve(views, model2);
+		reconstructAvgColor(views, model2);
 		model2.handleUnseen();
 		applyClosure(&model2, 3);
 		marchingCubes(&model2, parser.get<float>("scale"), modelTranslation, 0.5f, "out/bench/mesh_medium_1_avg.off");
@@ -373,8 +620,8 @@ int main(int argc, char* argv[])
 		Benchmark::GetInstance().NextRun("Medium, V1, closest coloring\t", Vector4f(50, 50, 25, 0.0056f));
 		Benchmark::GetInstance().LogOverall(true);
 		Model model2b = Model(50, 50, 25, 0.0056f);
-		carve(cameraMatrix, distCoeffs, model2b, images, masks);
-		reconstructAvgColor(cameraMatrix, distCoeffs, model2b, images, masks);
+		carve(views, model2b);
+		reconstructAvgColor(views, model2b);
 		model2b.handleUnseen();
 		applyClosure(&model2b, 3);
 		marchingCubes(&model2b, parser.get<float>("scale"), modelTranslation, 0.5f, "out/bench/mesh_medium_1_closest.off");
@@ -384,19 +631,29 @@ int main(int argc, char* argv[])
 		Benchmark::GetInstance().NextRun("Large, V1, avg. coloring\t", Vector4f(100, 100, 50, 0.0028f));
 		Benchmark::GetInstance().LogOverall(true);
 		Model model3 = Model(100, 100, 50, 0.0028f);
-		carve(cameraMatrix, distCoeffs, model3, images, masks);
-		reconstructAvgColor(cameraMatrix, distCoeffs, model3, images, masks);
+		carve(views, model3);
+		reconstructAvgColor(views, model3);
 		model3.handleUnseen();
 		applyClosure(&model3, 3);
 		marchingCubes(&model3, parser.get<float>("scale"), modelTranslation, 0.5f, "out/bench/mesh_large_1_avg.off");
 		Benchmark::GetInstance().LogOverall(false);
 
+		// large, v1 fused, avg coloring
+		Benchmark::GetInstance().NextRun("Large, V1 fused, avg. coloring\t", Vector4f(100, 100, 50, 0.0028f));
+		Benchmark::GetInstance().LogOverall(true);
+		Model model3f = Model(100, 100, 50, 0.0028f);
+		carveAndReconstructColor(views, model3f, 2);
+		model3f.handleUnseen();
+		applyClosure(&model3f, 3);
+		marchingCubes(&model3f, parser.get<float>("scale"), modelTranslation, 0.5f, "out/bench/mesh_large_1f_avg.off");
+		Benchmark::GetInstance().LogOverall(false);
+
 		// small, v2, avg coloring
 		Benchmark::GetInstance().NextRun("Small, V2, avg. coloring\t", Vector4f(10, 10, 5, 0.028f));
 		Benchmark::GetInstance().LogOverall(true);
 		Model model4 = Model(10, 10, 5, 0.028f);
-		fastCarve(cameraMatrix, distCoeffs, model4, images, masks);
-		reconstructAvgColor(cameraMatrix, distCoeffs, model4, images, masks);
+		fastCarve(views, model4);
+		reconstructAvgColor(views, model4);
 		model4.handleUnseen();
 		applyClosure(&model4, 3);
 		marchingCubes(&model4, parser.get<float>("scale"), modelTranslation, 0.5f, "out/bench/mesh_small_2_avg.off");
@@ -406,8 +663,8 @@ int main(int argc, char* argv[])
 		Benchmark::GetInstance().NextRun("Medium, V2, avg. coloring\t", Vector4f(50, 50, 25, 0.0056f));
 		Benchmark::GetInstance().LogOverall(true);
 		Model model5 = Model(50, 50, 25, 0.0056f);
-		fastCarve(cameraMatrix, distCoeffs, model5, images, masks);
-		reconstructAvgColor(cameraMatrix, distCoeffs, model5, images, masks);
+		fastCarve(views, model5);
+		reconstructAvgColor(views, model5);
 		model5.handleUnseen();
 		applyClosure(&model5, 3);
 		marchingCubes(&model5, parser.get<float>("scale"), modelTranslation, 0.5f, "out/bench/mesh_medium_2_avg.off");
@@ -417,8 +674,8 @@ int main(int argc, char* argv[])
 		Benchmark::GetInstance().NextRun("Medium, V2, closest coloring\t", Vector4f(50, 50, 25, 0.0056f));
 		Benchmark::GetInstance().LogOverall(true);
 		Model model6b = Model(50, 50, 25, 0.0056f);
-		fastCarve(cameraMatrix, distCoeffs, model6b, images, masks);
-		reconstructAvgColor(cameraMatrix, distCoeffs, model6b, images, masks);
+		fastCarve(views, model6b);
+		reconstructAvgColor(views, model6b);
 		model6b.handleUnseen();
 		applyClosure(&model6b, 3);
 		marchingCubes(&model6b, parser.get<float>("scale"), modelTranslation, 0.5f, "out/bench/mesh_medium_2_closest.off");
@@ -428,16 +685,39 @@ int main(int argc, char* argv[])
 		Benchmark::GetInstance().NextRun("Large, V2, avg. coloring\t", Vector4f(100, 100, 50, 0.0028f));
 		Benchmark::GetInstance().LogOverall(true);
 		Model model7 = Model(100, 100, 50, 0.0028f);
-		fastCarve(cameraMatrix, distCoeffs, model7, images, masks);
-		reconstructAvgColor(cameraMatrix, distCoeffs, model7, images, masks);
+		fastCarve(views, model7);
+		reconstructAvgColor(views, model7);
 		model7.handleUnseen();
 		applyClosure(&model7, 3);
 		marchingCubes(&model7, parser.get<float>("scale"), modelTranslation, 0.5f, "out/bench/mesh_large_2_avg.off");
 		Benchmark::GetInstance().LogOverall(false);
 
+		// huge, v1, avg coloring, voxels in slices and in bricks (same stages and result, memory order only)
+		for (VoxelLayout layout : { VoxelLayout::Linear, VoxelLayout::Bricked }) {
+			bool bricked = layout == VoxelLayout::Bricked;
+			Benchmark::GetInstance().NextRun(bricked ? "Huge, V1 bricked, avg. coloring" : "Huge, V1 linear, avg. coloring\t", Vector4f(256, 256, 256, 0.0011f));
+			Benchmark::GetInstance().LogOverall(true);
+			Model model8 = Model(256, 256, 256, 0.0011f, ModelStorage::Dense, cv::Vec3i(0, 0, 0), layout);
+			carve(views, model8);
+			reconstructAvgColor(views, model8);
+			model8.handleUnseen();
+			applyClosure(&model8, 3);
+			marchingCubes(&model8, parser.get<float>("scale"), modelTranslation, 0.5f, bricked ? "out/bench/mesh_huge_1_bricked.off" : "out/bench/mesh_huge_1_linear.off");
+			Benchmark::GetInstance().LogOverall(false);
+		}
+
 		std::cout << Benchmark::GetInstance().to_string() << std::endl;
 	}
 	break;
+	case 7: // consistency checks of the optimized code paths against their reference, needs no input
+	{
+		bool ok = checkProjectionKernels();
+		ok = checkRowProjection() && ok;
+		ok = checkCarvingEngines() && ok;
+		ok = checkSnapshotInPlace("./out/tmp/check_snapshot.bin") && ok;
+		std::cout << "LOG - Check: " << (ok ? "all checks passed." : "checks FAILED.") << std::endl;
+		return ok ? 0 : 1;
+	}
 	default:
 		break;
 	}